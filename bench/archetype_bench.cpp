@@ -0,0 +1,161 @@
+// Benchmark of the physics integration and AABB recompute for 100k moving entities,
+// once on the ECSRegistry containers (array of structs, Motion/Object group) and once on
+// the archetype registry (chunks laid out as structure of arrays)
+
+// stlib
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// internal
+#include "archetype_registry.hpp"
+#include "tiny_ecs_registry.hpp"
+#include "world_init.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+typedef ArchetypeRegistry<Motion, Object, BoundingBox> SoARegistry;
+
+const size_t entity_count = 100000;
+const int steps = 50;
+const float step_seconds = 16.f / 1000.f;
+
+// The integration of PhysicsSystem::step and the AABB update of WorldSystem::update_bounding_boxes
+void step_aos()
+{
+	registry.motionObjects.each([&](Entity, Motion& motion, Object& object)
+	{
+		float c = cosf(object.angle);
+		float s = sinf(object.angle);
+		vec2 input = { c * motion.input_velocity.x - s * motion.input_velocity.y,
+		               s * motion.input_velocity.x + c * motion.input_velocity.y };
+		vec2 result = input + motion.external_velocity;
+		object.position += result * step_seconds;
+	});
+	registry.view<BoundingBox, Object>().each([](Entity, BoundingBox& bb, Object& object) {
+		vec4 bb_info = calculate_AABB(object);
+		bb.bounding_box = vec2(bb_info.x, bb_info.y);
+		bb.pos = vec2(bb_info.z, bb_info.w);
+	});
+}
+
+// The same computation on float columns. The AABB of a box rotated around its center is
+// centered on the box and extends |c| * hx + |s| * hy horizontally, which is what calculate_AABB finds
+void step_soa(SoARegistry& soa)
+{
+	static const unsigned int position = lane_of(&Object::position);
+	static const unsigned int angle = lane_of(&Object::angle);
+	static const unsigned int scale = lane_of(&Object::scale);
+	static const unsigned int input_velocity = lane_of(&Motion::input_velocity);
+	static const unsigned int external_velocity = lane_of(&Motion::external_velocity);
+	static const unsigned int bounding_box = lane_of(&BoundingBox::bounding_box);
+	static const unsigned int bb_pos = lane_of(&BoundingBox::pos);
+
+	soa.each_chunk<Motion, Object>([&](const SoARegistry::ChunkView& chunk)
+	{
+		float* __restrict px = chunk.lane<Object>(position);
+		float* __restrict py = chunk.lane<Object>(position + 1);
+		const float* __restrict a = chunk.lane<Object>(angle);
+		const float* __restrict ivx = chunk.lane<Motion>(input_velocity);
+		const float* __restrict ivy = chunk.lane<Motion>(input_velocity + 1);
+		const float* __restrict evx = chunk.lane<Motion>(external_velocity);
+		const float* __restrict evy = chunk.lane<Motion>(external_velocity + 1);
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			float c = cosf(a[i]);
+			float s = sinf(a[i]);
+			px[i] += ((c * ivx[i] - s * ivy[i]) + evx[i]) * step_seconds;
+			py[i] += ((s * ivx[i] + c * ivy[i]) + evy[i]) * step_seconds;
+		}
+	});
+	soa.each_chunk<Object, BoundingBox>([&](const SoARegistry::ChunkView& chunk)
+	{
+		const float* __restrict px = chunk.lane<Object>(position);
+		const float* __restrict py = chunk.lane<Object>(position + 1);
+		const float* __restrict a = chunk.lane<Object>(angle);
+		const float* __restrict sx = chunk.lane<Object>(scale);
+		const float* __restrict sy = chunk.lane<Object>(scale + 1);
+		float* __restrict bw = chunk.lane<BoundingBox>(bounding_box);
+		float* __restrict bh = chunk.lane<BoundingBox>(bounding_box + 1);
+		float* __restrict bx = chunk.lane<BoundingBox>(bb_pos);
+		float* __restrict by = chunk.lane<BoundingBox>(bb_pos + 1);
+		for (unsigned int i = 0; i < chunk.count; i++)
+		{
+			float hx = fabsf(sx[i]) / 2.f;
+			float hy = fabsf(sy[i]) / 2.f;
+			float c = fabsf(cosf(a[i]));
+			float s = fabsf(sinf(a[i]));
+			float ex = hx * c + hy * s;
+			float ey = hx * s + hy * c;
+			bw[i] = ex - -ex;
+			bh[i] = ey - -ey;
+			bx[i] = px[i];
+			by[i] = py[i];
+		}
+	});
+}
+
+int main()
+{
+	std::default_random_engine rng(427);
+	std::uniform_real_distribution<float> uniform_dist;
+	SoARegistry soa;
+
+	// the moving entities, plus a tracker line (Object only) for every fourth to mimic the game's mix
+	std::vector<Entity> movers;
+	for (size_t i = 0; i < entity_count; i++)
+	{
+		Entity entity;
+		Motion motion;
+		motion.input_velocity = { -100.f * uniform_dist(rng), 20.f * uniform_dist(rng) };
+		motion.external_velocity = { uniform_dist(rng), uniform_dist(rng) };
+		Object object;
+		object.position = { window_width_px * uniform_dist(rng), window_height_px * uniform_dist(rng) };
+		object.angle = 6.28f * uniform_dist(rng);
+		object.scale = { -99.f, 99.f }; // the scale of the fish prefab
+		BoundingBox bb;
+
+		registry.motions.insert(entity, motion);
+		registry.objects.insert(entity, object);
+		registry.boundingBoxes.insert(entity, bb);
+		soa.create(entity, motion, object, bb);
+		movers.push_back(entity);
+
+		if (i % 4 == 0)
+		{
+			Entity line;
+			registry.objects.insert(line, object);
+			soa.create(line, object);
+		}
+	}
+
+	double aos_ms = 1e300, soa_ms = 1e300;
+	for (int round = 0; round < 3; round++)
+	{
+		auto t = Clock::now();
+		for (int i = 0; i < steps; i++)
+			step_aos();
+		aos_ms = std::min(aos_ms, std::chrono::duration<double, std::milli>(Clock::now() - t).count() / steps);
+
+		t = Clock::now();
+		for (int i = 0; i < steps; i++)
+			step_soa(soa);
+		soa_ms = std::min(soa_ms, std::chrono::duration<double, std::milli>(Clock::now() - t).count() / steps);
+	}
+
+	// both layouts ran the same number of steps, so the results should agree
+	float max_difference = 0.f;
+	for (Entity e : movers)
+	{
+		Object object = soa.get<Object>(e);
+		BoundingBox bb = soa.get<BoundingBox>(e);
+		max_difference = std::max(max_difference, length(object.position - registry.objects.get(e).position));
+		max_difference = std::max(max_difference, length(bb.bounding_box - registry.boundingBoxes.get(e).bounding_box));
+	}
+
+	printf("%zu moving entities, ms per step (integration + AABB)\n", entity_count);
+	printf("array of structs (ComponentContainer): %8.3f\n", aos_ms);
+	printf("structure of arrays (archetype chunks): %8.3f\n", soa_ms);
+	printf("max difference between the layouts:    %8.5f\n", max_difference);
+	return 0;
+}
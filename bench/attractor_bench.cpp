@@ -0,0 +1,77 @@
+// Benchmark of the attractor force pass of PhysicsSystem::step for a "whirlpool storm": 10k entities
+// on the 1200 x 800 window and 2 to 2000 whirlpools of the sizes the game spawns. The direct sum over
+// all attractors is compared with the Barnes-Hut quadtree of AttractorField. The error of the tree is
+// given relative to the velocities (root mean square), and as the largest difference relative to the
+// force of an average whirlpool.
+// The tree doesn't pay off at these sizes. A typical run (ms for direct / tree, then largest error):
+//   128 whirlpools:  8.9 / 8.7, 0.04
+//   512 whirlpools: 39.4 / 44.9, 0.13
+//  2000 whirlpools: 167 / 162, 0.23
+// Building the tree is a small part of its time, nearly all of it goes to the queries.
+
+// stlib
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// internal
+#include "attractor_field.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+const size_t entity_count = 10000;
+const int rounds = 10;
+
+// ms per round of building the field and evaluating it at every position
+double run(AttractorField& field, const std::vector<vec3>& whirlpools, const std::vector<vec2>& positions, std::vector<vec2>& velocities)
+{
+	auto t = Clock::now();
+	for (int round = 0; round < rounds; round++)
+	{
+		field.clear();
+		for (const vec3& whirlpool : whirlpools)
+			field.add(vec2(whirlpool.x, whirlpool.y), 300.f * whirlpool.z, 40.f * whirlpool.z);
+		field.build();
+		for (size_t i = 0; i < positions.size(); i++)
+			velocities[i] = field.velocity_at(positions[i]);
+	}
+	return std::chrono::duration<double, std::milli>(Clock::now() - t).count() / rounds;
+}
+
+int main()
+{
+	std::default_random_engine rng(427);
+	std::uniform_real_distribution<float> uniform_dist;
+
+	std::vector<vec2> positions(entity_count);
+	for (vec2& position : positions)
+		position = { 1200.f * uniform_dist(rng), 800.f * uniform_dist(rng) };
+	std::vector<vec2> direct_velocities(entity_count), tree_velocities(entity_count);
+
+	printf("%8s %10s %10s %10s %10s\n", "whirls", "direct ms", "tree ms", "rms error", "max error");
+	const size_t counts[] = { 2, 32, 128, 512, 2000 };
+	for (size_t count : counts)
+	{
+		// position and size, as spawned by WorldSystem::step
+		std::vector<vec3> whirlpools(count);
+		for (vec3& whirlpool : whirlpools)
+			whirlpool = { (1200.f - 100.f) * uniform_dist(rng) + 50.f, (800.f - 70.f) * uniform_dist(rng) + 35.f, uniform_dist(rng) + 0.25f };
+
+		AttractorField direct((size_t)-1);
+		AttractorField tree(0);
+		double direct_ms = run(direct, whirlpools, positions, direct_velocities);
+		double tree_ms = run(tree, whirlpools, positions, tree_velocities);
+
+		double error_squared = 0.0, velocity_squared = 0.0;
+		float max_error = 0.f;
+		for (size_t i = 0; i < entity_count; i++)
+		{
+			vec2 error = direct_velocities[i] - tree_velocities[i];
+			error_squared += dot(error, error);
+			velocity_squared += dot(direct_velocities[i], direct_velocities[i]);
+			max_error = std::max(max_error, length(error));
+		}
+		printf("%8zu %10.3f %10.3f %10.4f %10.4f\n", count, direct_ms, tree_ms, sqrt(error_squared / velocity_squared), max_error / (40.f * 0.75f));
+	}
+	return 0;
+}
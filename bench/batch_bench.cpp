@@ -0,0 +1,80 @@
+// Benchmark of the batched ECSRegistry::create_n and destroy_n against creating entities one at a time
+// with emplace() and removing them one at a time with remove_all_components_of, for a wave of fish
+// (Motion, Object, Eatable) as spawned by WorldSystem::step. The wave comes and goes next to a standing
+// population of fish that stays, so the removals are spread over larger containers like in the game.
+// Each row also checks that both ways leave the registry in the same state.
+
+// stlib
+#include <chrono>
+#include <cstdio>
+
+// internal
+#include "tiny_ecs_registry.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+const int rounds = 20;
+const size_t standing_count = 16384;
+
+struct Timings
+{
+	double create_ms = 1e300;
+	double destroy_ms = 1e300;
+	bool same = true;
+};
+
+template <typename Create, typename Destroy>
+void run(size_t count, Timings& timings, Create create, Destroy destroy)
+{
+	std::vector<Entity> created;
+	for (int round = 0; round < rounds; round++)
+	{
+		created.clear();
+		auto t = Clock::now();
+		create(count, created);
+		timings.create_ms = std::min(timings.create_ms, std::chrono::duration<double, std::milli>(Clock::now() - t).count());
+		size_t size = standing_count + count;
+		timings.same = timings.same && registry.motions.size() == size && registry.objects.size() == size && registry.eatables.size() == size;
+
+		t = Clock::now();
+		destroy(created);
+		timings.destroy_ms = std::min(timings.destroy_ms, std::chrono::duration<double, std::milli>(Clock::now() - t).count());
+		timings.same = timings.same && registry.motions.size() == standing_count && registry.objects.size() == standing_count
+			&& registry.eatables.size() == standing_count && Entity::free_count() + 1 + standing_count == Entity::capacity();
+	}
+}
+
+int main()
+{
+	std::vector<Entity> standing;
+	registry.create_n(standing_count, standing, Motion(), Object(), Eatable());
+
+	printf("waves of fish next to %zu standing fish\n", standing_count);
+	printf("%8s %14s %14s %14s %14s %6s\n", "entities", "emplace ms", "create_n ms", "remove ms", "destroy_n ms", "same");
+	const size_t counts[] = { 16, 256, 4096, 65536 };
+	for (size_t count : counts)
+	{
+		Timings single, batched;
+		run(count, single,
+			[](size_t n, std::vector<Entity>& created) {
+				for (size_t i = 0; i < n; i++)
+				{
+					Entity e;
+					registry.motions.emplace(e);
+					registry.objects.emplace(e);
+					registry.eatables.emplace(e);
+					created.push_back(e);
+				}
+			},
+			[](const std::vector<Entity>& created) {
+				for (Entity e : created)
+					registry.remove_all_components_of(e);
+			});
+		run(count, batched,
+			[](size_t n, std::vector<Entity>& created) { registry.create_n(n, created, Motion(), Object(), Eatable()); },
+			[](const std::vector<Entity>& created) { registry.destroy_n(created); });
+		printf("%8zu %14.3f %14.3f %14.3f %14.3f %6s\n", count, single.create_ms, batched.create_ms, single.destroy_ms, batched.destroy_ms,
+			single.same && batched.same ? "yes" : "NO");
+	}
+	return 0;
+}
@@ -0,0 +1,143 @@
+// Benchmark of the collision check of PhysicsSystem::step: the brute force double loop over all
+// objects, the SpatialHashGrid broadphase and the AabbTreeBroadphase, for 100 to 100k objects at the
+// density of the game (one fish plus its four tracker lines per 5 objects). The "mixed" scene adds
+// whirlpools and a few long lines, whose sizes differ by more than an order of magnitude.
+// Every step moves all objects a little, like the game does.
+
+// stlib
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// internal
+#include "physics_system.hpp"
+#include "spatial_hash_grid.hpp"
+#include "dynamic_aabb_tree.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+// roughly 100 objects on the 1200 x 800 window
+const float area_per_object = 1200.f * 800.f / 100.f;
+const int steps = 10;
+
+std::vector<Object> make_objects(size_t count, bool mixed, std::default_random_engine& rng)
+{
+	std::uniform_real_distribution<float> uniform_dist;
+	float side = sqrtf(area_per_object * count);
+	std::vector<Object> objects;
+	while (objects.size() < count)
+	{
+		Object fish;
+		fish.position = { side * uniform_dist(rng), side * uniform_dist(rng) };
+		fish.scale = { -99.f, 99.f };
+		if (mixed && uniform_dist(rng) < 0.05f)
+			fish.scale = vec2(-150.f, 150.f) * (uniform_dist(rng) + 0.25f); // a whirlpool
+		if (mixed && uniform_dist(rng) < 0.005f)
+			fish.scale = { 800.f, 10.f }; // a long line
+		objects.push_back(fish);
+		vec2 offsets[4] = { { 0.f, -49.5f }, { 0.f, 49.5f }, { -49.5f, 0.f }, { 49.5f, 0.f } };
+		vec2 scales[4] = { { 99.f, 10.f }, { 99.f, 10.f }, { 10.f, 99.f }, { 10.f, 99.f } };
+		for (int i = 0; i < 4 && objects.size() < count; i++)
+		{
+			Object line;
+			line.position = fish.position + offsets[i];
+			line.scale = scales[i];
+			objects.push_back(line);
+		}
+	}
+	return objects;
+}
+
+// Everything drifts left, about what a fish covers in one frame
+void move_objects(std::vector<Object>& objects, int step)
+{
+	for (size_t i = 0; i < objects.size(); i++)
+		objects[i].position += vec2(-1.f, (float)((i + step) % 3) - 1.f);
+}
+
+void brute_force(const std::vector<Object>& objects, std::vector<ObjectPair>& hits)
+{
+	hits.clear();
+	for (unsigned int i = 0; i < objects.size(); i++)
+		for (unsigned int j = i + 1; j < objects.size(); j++)
+			if (collides(objects[i], objects[j]))
+				hits.push_back({ i, j });
+}
+
+void narrowphase(const std::vector<Object>& objects, const std::vector<ObjectPair>& candidates, std::vector<ObjectPair>& hits)
+{
+	hits.clear();
+	for (const ObjectPair& pair : candidates)
+		if (collides(objects[pair.first], objects[pair.second]))
+			hits.push_back(pair);
+}
+
+bool same_hits(const std::vector<ObjectPair>& a, const std::vector<ObjectPair>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+		if (a[i].first != b[i].first || a[i].second != b[i].second)
+			return false;
+	return true;
+}
+
+// ms per step of 'func', which gets the step number
+template <typename Func>
+double ms_per_step(Func func)
+{
+	auto t = Clock::now();
+	for (int step = 0; step < steps; step++)
+		func(step);
+	return std::chrono::duration<double, std::milli>(Clock::now() - t).count() / steps;
+}
+
+int main()
+{
+	std::default_random_engine rng(427);
+	std::vector<ObjectPair> candidates, grid_hits, tree_hits, brute_hits;
+
+	printf("%6s %8s %10s %10s %10s %10s %10s %s\n", "scene", "objects", "brute ms", "grid ms", "tree ms", "tree h", "hits", "same result");
+	const size_t counts[] = { 100, 1000, 10000, 100000 };
+	for (int mixed = 0; mixed < 2; mixed++)
+	{
+		for (size_t count : counts)
+		{
+			std::vector<Object> initial = make_objects(count, mixed != 0, rng);
+			std::vector<Entity> entities(count);
+			// the double loop takes seconds for 100k objects
+			bool run_brute = count <= 10000;
+
+			std::vector<Object> objects = initial;
+			SpatialHashGrid grid;
+			double grid_ms = ms_per_step([&](int step) {
+				move_objects(objects, step);
+				grid.find_pairs(objects.data(), objects.size(), candidates);
+				narrowphase(objects, candidates, grid_hits);
+			});
+
+			objects = initial;
+			AabbTreeBroadphase tree;
+			tree.find_pairs(objects.data(), entities.data(), objects.size(), candidates); // initial build
+			double tree_ms = ms_per_step([&](int step) {
+				move_objects(objects, step);
+				tree.find_pairs(objects.data(), entities.data(), objects.size(), candidates);
+				narrowphase(objects, candidates, tree_hits);
+			});
+
+			double brute_ms = 0.0;
+			if (run_brute)
+			{
+				objects = initial;
+				brute_ms = ms_per_step([&](int step) {
+					move_objects(objects, step);
+					brute_force(objects, brute_hits);
+				});
+			}
+			bool same = same_hits(grid_hits, tree_hits) && (!run_brute || same_hits(brute_hits, grid_hits));
+			printf("%6s %8zu %10.3f %10.3f %10.3f %10d %10zu %s\n", mixed ? "mixed" : "game", count, brute_ms, grid_ms, tree_ms,
+				tree.get_tree().height(), tree_hits.size(), same ? "yes" : "NO");
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,158 @@
+// Microbenchmark comparing the sparse-set ComponentContainer with the previous
+// std::unordered_map backed container on the access patterns used by the game systems
+
+// stlib
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+
+// internal
+#include "tiny_ecs.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Same size as the Motion component (7 floats)
+struct BenchMotion
+{
+	float values[7] = { 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f };
+};
+
+// The same component stored with the pointer-stable paged storage policy
+struct PagedBenchMotion : BenchMotion
+{
+};
+template <> struct component_storage<PagedBenchMotion> { typedef PagedVector<PagedBenchMotion> type; };
+
+// The previous container implementation, where every lookup is a hash map probe
+template <typename Component>
+class MapComponentContainer
+{
+	std::unordered_map<unsigned int, unsigned int> map_entity_componentID;
+public:
+	std::vector<Component> components;
+	std::vector<Entity> entities;
+
+	Component& insert(Entity e, Component c)
+	{
+		map_entity_componentID[e] = (unsigned int)components.size();
+		components.push_back(std::move(c));
+		entities.push_back(e);
+		return components.back();
+	}
+	template<typename... Args>
+	Component& emplace(Entity e, Args &&... args) {
+		return insert(e, Component(std::forward<Args>(args)...));
+	}
+	Component& get(Entity e) {
+		return components[map_entity_componentID[e]];
+	}
+	bool has(Entity entity) {
+		return map_entity_componentID.count(entity) > 0;
+	}
+	void remove(Entity e)
+	{
+		if (has(e))
+		{
+			int cID = map_entity_componentID[e];
+			components[cID] = std::move(components.back());
+			entities[cID] = entities.back();
+			map_entity_componentID[entities.back()] = cID;
+			map_entity_componentID.erase(e);
+			components.pop_back();
+			entities.pop_back();
+		}
+	}
+	size_t size() { return components.size(); }
+};
+
+// Keeps the optimizer from discarding the benchmarked work
+static volatile float sink;
+
+// Runs 'work' several times and returns the fastest run in nanoseconds per operation
+template <typename Work>
+double best_ns_per_op(size_t ops, Work work)
+{
+	const int repetitions = 7;
+	double best = 1e300;
+	for (int r = 0; r < repetitions; r++)
+	{
+		auto t = Clock::now();
+		work();
+		double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count();
+		best = std::min(best, ns / (double)ops);
+	}
+	return best;
+}
+
+template <class Container>
+void run(const char* name, const std::vector<Entity>& entities, const std::vector<Entity>& shuffled, const std::vector<Entity>& probes)
+{
+	size_t n = entities.size();
+
+	double insert_remove = best_ns_per_op(2 * n, [&]() {
+		Container c;
+		for (Entity e : entities)
+			c.emplace(e);
+		for (Entity e : shuffled)
+			c.remove(e);
+		sink = (float)c.size();
+	});
+
+	Container c;
+	for (Entity e : entities)
+		c.emplace(e);
+
+	// the physics loop pattern: walk one container and look the entity up again
+	double iterate_get = best_ns_per_op(n, [&]() {
+		float sum = 0.f;
+		for (size_t i = 0; i < c.size(); i++)
+			sum += c.get(c.entities[i]).values[0];
+		sink = sum;
+	});
+
+	double random_get = best_ns_per_op(n, [&]() {
+		float sum = 0.f;
+		for (Entity e : shuffled)
+			sum += c.get(e).values[3];
+		sink = sum;
+	});
+
+	// half of the probes are not contained, like players.has() on every moving entity
+	double has = best_ns_per_op(probes.size(), [&]() {
+		int count = 0;
+		for (Entity e : probes)
+			count += c.has(e) ? 1 : 0;
+		sink = (float)count;
+	});
+
+	printf("%-8s %8zu %14.2f %14.2f %14.2f %14.2f\n", name, n, insert_remove, iterate_get, random_get, has);
+}
+
+int main()
+{
+	std::default_random_engine rng(427);
+	printf("%-8s %8s %14s %14s %14s %14s\n", "storage", "entities", "ins+rem ns/op", "iter+get ns/op", "rand get ns/op", "has ns/op");
+
+	for (size_t n : { 1000, 5000, 20000, 100000 })
+	{
+		// every second entity is skipped to get a realistic, non-contiguous id distribution
+		std::vector<Entity> entities, probes;
+		for (size_t i = 0; i < 2 * n; i++)
+		{
+			Entity e;
+			if (i % 2 == 0)
+				entities.push_back(e);
+			probes.push_back(e);
+		}
+		std::vector<Entity> shuffled = entities;
+		std::shuffle(shuffled.begin(), shuffled.end(), rng);
+		std::shuffle(probes.begin(), probes.end(), rng);
+
+		run<MapComponentContainer<BenchMotion>>("map", entities, shuffled, probes);
+		run<ComponentContainer<BenchMotion>>("sparse", entities, shuffled, probes);
+		run<ComponentContainer<PagedBenchMotion>>("paged", entities, shuffled, probes);
+	}
+
+	return 0;
+}
@@ -0,0 +1,98 @@
+// Benchmark of the circle test of PhysicsSystem::step: collides() called once per candidate pair
+// against find_hits() with every kernel this CPU supports, on the CircleColliders gathered once per
+// step. The candidates come from the SpatialHashGrid at the density of the game, and from a crowded
+// scene where most candidates hit. Every kernel has to give exactly the hits of collides().
+
+// stlib
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// internal
+#include "physics_system.hpp"
+#include "narrowphase.hpp"
+#include "spatial_hash_grid.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+const size_t object_count = 100000;
+const int rounds = 20;
+
+// Fish and tracker line sized objects on 'area_per_object' each
+std::vector<Object> make_objects(float area_per_object, std::default_random_engine& rng)
+{
+	std::uniform_real_distribution<float> uniform_dist;
+	float side = sqrtf(area_per_object * object_count);
+	std::vector<Object> objects(object_count);
+	for (Object& object : objects)
+	{
+		object.position = { side * uniform_dist(rng), side * uniform_dist(rng) };
+		object.scale = uniform_dist(rng) < 0.2f ? vec2(-99.f, 99.f) : vec2(99.f, 10.f);
+		if (uniform_dist(rng) < 0.5f)
+			object.scale = vec2(object.scale.y, object.scale.x);
+	}
+	return objects;
+}
+
+bool same_hits(const std::vector<ObjectPair>& a, const std::vector<ObjectPair>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+		if (a[i].first != b[i].first || a[i].second != b[i].second)
+			return false;
+	return true;
+}
+
+// ms per round of 'func'
+template <typename Func>
+double ms_per_round(Func func)
+{
+	auto t = Clock::now();
+	for (int round = 0; round < rounds; round++)
+		func();
+	return std::chrono::duration<double, std::milli>(Clock::now() - t).count() / rounds;
+}
+
+int main()
+{
+	std::default_random_engine rng(427);
+	SpatialHashGrid grid;
+	std::vector<ObjectPair> candidates, reference, hits;
+	CircleColliders circles;
+
+	printf("widest kernel on this CPU: %s, fastest by calibration: %s\n", narrowphase_kernel_name(widest_narrowphase_kernel()),
+		narrowphase_kernel_name(best_narrowphase_kernel()));
+	printf("%8s %10s %10s %10s %10s %s\n", "scene", "pairs", "hits", "kernel", "ms", "same result");
+	const char* scenes[2] = { "game", "crowded" };
+	const float areas[2] = { 1200.f * 800.f / 100.f, 1200.f * 800.f / 2000.f };
+	for (int scene = 0; scene < 2; scene++)
+	{
+		std::vector<Object> objects = make_objects(areas[scene], rng);
+		grid.find_pairs(objects.data(), objects.size(), candidates);
+
+		double collides_ms = ms_per_round([&]() {
+			reference.clear();
+			for (const ObjectPair& pair : candidates)
+				if (collides(objects[pair.first], objects[pair.second]))
+					reference.push_back(pair);
+		});
+		printf("%8s %10zu %10zu %10s %10.3f %s\n", scenes[scene], candidates.size(), reference.size(), "collides", collides_ms, "-");
+
+		for (int k = 0; k <= (int)widest_narrowphase_kernel(); k++)
+		{
+			NarrowphaseKernel kernel = (NarrowphaseKernel)k;
+			// the gather is part of the cost, PhysicsSystem::step does it once per step
+			double ms = ms_per_round([&]() {
+				circles.clear();
+				for (const Object& object : objects)
+					circles.push_back(object.position, collision_radius_squared(object));
+				hits.clear();
+				find_hits(circles, candidates.data(), candidates.size(), hits, kernel);
+			});
+			printf("%8s %10zu %10zu %10s %10.3f %s\n", scenes[scene], candidates.size(), hits.size(),
+				narrowphase_kernel_name(kernel), ms, same_hits(reference, hits) ? "yes" : "NO");
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,60 @@
+// Regression checks of registry snapshots that the benchmarks don't cover, run with ctest.
+// Returns 0 if all checks pass.
+
+// stlib
+#include <cstdio>
+
+// internal
+#include "tiny_ecs_registry.hpp"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+	printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+	if (!ok)
+		failures++;
+}
+
+// A handle created after a snapshot, in a slot that was free when the snapshot was taken, must be
+// stale after loading it, even if it got the same generation the slot had in the snapshot
+static void stale_handle_in_free_slot()
+{
+	Entity a;
+	Entity b;
+	registry.objects.emplace(a);
+	registry.objects.emplace(b);
+	registry.remove_all_components_of(b);
+
+	std::vector<char> blob;
+	registry.save_snapshot(blob);
+
+	Entity c; // re-uses the slot of b
+	registry.objects.emplace(c);
+	check(c.index() == b.index(), "the handle created after the save re-uses the free slot");
+
+	check(registry.load_snapshot(blob), "the snapshot loads");
+	check(Entity::is_alive(a), "the entity of the snapshot is alive");
+	check(!Entity::is_alive(c), "the handle created after the save is stale");
+	check(!registry.objects.has(c), "the stale handle has no components");
+
+	size_t free_before = Entity::free_count();
+	registry.remove_all_components_of(c);
+	Entity::destroy(c);
+	check(Entity::free_count() == free_before, "destroying the stale handle frees nothing");
+
+	Entity d;
+	Entity e;
+	check((unsigned int)d != (unsigned int)e, "the next two entities get different ids");
+	check(d.index() != e.index(), "the next two entities get different slots");
+	check((unsigned int)d != (unsigned int)c && (unsigned int)e != (unsigned int)c, "no new entity gets the stale id");
+
+	registry.clear_all_components();
+}
+
+int main()
+{
+	stale_handle_in_free_slot();
+	printf("%d failures\n", failures);
+	return failures == 0 ? 0 : 1;
+}
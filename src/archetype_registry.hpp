@@ -0,0 +1,350 @@
+#pragma once
+
+// stlib
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <assert.h>
+
+#include "tiny_ecs.hpp"
+
+// An alternative to the ECSRegistry containers for hot, float-only components.
+// Entities with the same set of components (an "archetype") are stored together in fixed-size
+// chunks, and inside a chunk every float of a component gets its own column (structure of arrays):
+// all position.x, then all position.y, ... Systems then stream through contiguous float arrays,
+// which the compiler can vectorize, instead of striding over whole structs.
+//
+// Components stored here must consist of floats only (float, vec2, vec3, ...), e.g., Motion,
+// Object and BoundingBox. Each float of a component is called a lane, see lane_of().
+
+// Number of float lanes of a component
+template <typename Component>
+struct soa_lanes
+{
+	static_assert(std::is_trivially_copyable<Component>::value, "SoA components must be trivially copyable");
+	static_assert(sizeof(Component) % sizeof(float) == 0, "SoA components must consist of floats only");
+	static const unsigned int count = sizeof(Component) / sizeof(float);
+};
+template <typename Component>
+const unsigned int soa_lanes<Component>::count;
+
+// Lane of the first float of a member, e.g., lane_of(&Object::position) + 1 is the lane of position.y
+template <typename Component, typename Member>
+unsigned int lane_of(Member Component::* member)
+{
+	Component probe;
+	return (unsigned int)(((const char*)&(probe.*member) - (const char*)&probe) / sizeof(float));
+}
+
+template <typename... Component>
+class ArchetypeRegistry
+{
+public:
+	// Number of entities per chunk
+	static const unsigned int chunk_capacity = 1024;
+
+	// Bitmask over the component types, bit i stands for the i-th type of 'Component...'
+	typedef unsigned int Signature;
+	static_assert(sizeof...(Component) <= 32, "At most 32 component types are supported");
+
+	// The part of one chunk handed to systems by each_chunk()
+	struct ChunkView
+	{
+		unsigned int count; // number of entities in this chunk
+		const Entity* entities;
+
+		// The column of lane 'lane' of component T, count floats long
+		template <typename T>
+		float* lane(unsigned int lane) const
+		{
+			assert(lane < soa_lanes<T>::count);
+			assert(lane_offsets[type_index<T>()] != no_lane && "Component not part of this archetype");
+			return data + (size_t)(lane_offsets[type_index<T>()] + lane) * chunk_capacity;
+		}
+
+		float* data;
+		const unsigned int* lane_offsets;
+	};
+
+private:
+	static const unsigned int no_lane = ~0u;
+	static const unsigned int type_count = sizeof...(Component);
+
+	// Lane counts of all component types, in order
+	static const unsigned int* lane_counts()
+	{
+		static const unsigned int counts[] = { soa_lanes<Component>::count... };
+		return counts;
+	}
+
+	// Position of T in 'Component...'
+	template <typename T>
+	static constexpr unsigned int type_index()
+	{
+		return type_index_in<T, Component...>::value;
+	}
+
+	template <typename... T>
+	static Signature signature_of()
+	{
+		Signature signature = 0;
+		using expand = int[];
+		(void)expand{ 0, (signature |= 1u << type_index<T>(), 0)... };
+		return signature;
+	}
+
+	struct Archetype
+	{
+		Signature signature;
+		unsigned int lane_offsets[type_count]; // first lane of every component type, no_lane if not contained
+		unsigned int lanes; // total number of float lanes of an entity
+		unsigned int size = 0; // number of entities, entity slot i lives in chunk i / chunk_capacity
+		std::vector<std::unique_ptr<float[]>> chunks; // lanes * chunk_capacity floats each
+		std::vector<Entity> entities; // all entities in slot order
+
+		float& at(unsigned int slot, unsigned int lane)
+		{
+			return chunks[slot / chunk_capacity][(size_t)lane * chunk_capacity + slot % chunk_capacity];
+		}
+	};
+
+	// Where an entity lives, indexed by Entity::index()
+	struct Location
+	{
+		unsigned int archetype = no_lane;
+		unsigned int slot = 0;
+	};
+
+	std::vector<Archetype> archetypes;
+	std::vector<Location> locations;
+	size_t entity_count = 0;
+
+	unsigned int find_or_create_archetype(Signature signature)
+	{
+		for (unsigned int i = 0; i < archetypes.size(); i++)
+			if (archetypes[i].signature == signature)
+				return i;
+
+		Archetype archetype;
+		archetype.signature = signature;
+		archetype.lanes = 0;
+		for (unsigned int t = 0; t < type_count; t++)
+		{
+			if (signature & (1u << t))
+			{
+				archetype.lane_offsets[t] = archetype.lanes;
+				archetype.lanes += lane_counts()[t];
+			}
+			else
+				archetype.lane_offsets[t] = no_lane;
+		}
+		archetypes.push_back(std::move(archetype));
+		return (unsigned int)archetypes.size() - 1;
+	}
+
+	Location* find(Entity e)
+	{
+		if (e.index() >= locations.size() || locations[e.index()].archetype == no_lane)
+			return nullptr;
+		Location& location = locations[e.index()];
+		if ((unsigned int)archetypes[location.archetype].entities[location.slot] != (unsigned int)e)
+			return nullptr;
+		return &location;
+	}
+
+	// Append e to an archetype, its lanes are left uninitialized
+	void push(Entity e, unsigned int archetype_id)
+	{
+		Archetype& archetype = archetypes[archetype_id];
+		unsigned int slot = archetype.size++;
+		if (slot / chunk_capacity >= archetype.chunks.size())
+			archetype.chunks.emplace_back(new float[(size_t)archetype.lanes * chunk_capacity]);
+		archetype.entities.push_back(e);
+
+		if (e.index() >= locations.size())
+			locations.resize(e.index() + 1);
+		locations[e.index()].archetype = archetype_id;
+		locations[e.index()].slot = slot;
+	}
+
+	// Remove the entity in 'slot' by moving the last entity of the archetype into it
+	void pop(unsigned int archetype_id, unsigned int slot)
+	{
+		Archetype& archetype = archetypes[archetype_id];
+		unsigned int last = --archetype.size;
+		if (slot != last)
+		{
+			for (unsigned int lane = 0; lane < archetype.lanes; lane++)
+				archetype.at(slot, lane) = archetype.at(last, lane);
+			archetype.entities[slot] = archetype.entities[last];
+			locations[archetype.entities[slot].index()].slot = slot;
+		}
+		archetype.entities.pop_back();
+	}
+
+	template <typename T>
+	void scatter(Archetype& archetype, unsigned int slot, const T& component)
+	{
+		float lanes[soa_lanes<T>::count];
+		std::memcpy(lanes, &component, sizeof(T));
+		unsigned int offset = archetype.lane_offsets[type_index<T>()];
+		for (unsigned int lane = 0; lane < soa_lanes<T>::count; lane++)
+			archetype.at(slot, offset + lane) = lanes[lane];
+	}
+
+	template <typename T>
+	T gather(Archetype& archetype, unsigned int slot)
+	{
+		float lanes[soa_lanes<T>::count];
+		unsigned int offset = archetype.lane_offsets[type_index<T>()];
+		for (unsigned int lane = 0; lane < soa_lanes<T>::count; lane++)
+			lanes[lane] = archetype.at(slot, offset + lane);
+		T component;
+		std::memcpy(&component, lanes, sizeof(T));
+		return component;
+	}
+
+	// Move e to the archetype with 'signature', keeping the lanes of the components both have in common
+	Location& migrate(Entity e, Signature signature)
+	{
+		Location from = *find(e);
+		unsigned int to_id = find_or_create_archetype(signature);
+		push(e, to_id);
+		Archetype& source = archetypes[from.archetype];
+		Archetype& target = archetypes[to_id];
+		unsigned int to_slot = target.size - 1;
+		for (unsigned int t = 0; t < type_count; t++)
+		{
+			if (source.lane_offsets[t] == no_lane || target.lane_offsets[t] == no_lane)
+				continue;
+			for (unsigned int lane = 0; lane < lane_counts()[t]; lane++)
+				target.at(to_slot, target.lane_offsets[t] + lane) = source.at(from.slot, source.lane_offsets[t] + lane);
+		}
+		pop(from.archetype, from.slot);
+		return locations[e.index()];
+	}
+
+public:
+	// Add entity e with the given components, e.g., create(e, Motion(), Object())
+	template <typename... T>
+	void create(Entity e, const T&... components)
+	{
+		assert(find(e) == nullptr && "Entity already contained in the archetype registry");
+		unsigned int archetype_id = find_or_create_archetype(signature_of<T...>());
+		push(e, archetype_id);
+		Archetype& archetype = archetypes[archetype_id];
+		using expand = int[];
+		(void)expand{ 0, (scatter(archetype, archetype.size - 1, components), 0)... };
+		entity_count++;
+	}
+
+	// Remove entity e and all its components
+	void destroy(Entity e)
+	{
+		Location* location = find(e);
+		if (location == nullptr)
+			return;
+		pop(location->archetype, location->slot);
+		location->archetype = no_lane;
+		entity_count--;
+	}
+
+	bool contains(Entity e)
+	{
+		return find(e) != nullptr;
+	}
+
+	template <typename T>
+	bool has(Entity e)
+	{
+		Location* location = find(e);
+		return location != nullptr && (archetypes[location->archetype].signature & signature_of<T>()) != 0;
+	}
+
+	// A copy of the component, assembled from its lanes
+	template <typename T>
+	T get(Entity e)
+	{
+		assert(has<T>(e) && "Entity not contained in the archetype registry");
+		Location* location = find(e);
+		return gather<T>(archetypes[location->archetype], location->slot);
+	}
+
+	// Overwrite the component of an entity
+	template <typename T>
+	void set(Entity e, const T& component)
+	{
+		assert(has<T>(e) && "Entity not contained in the archetype registry");
+		Location* location = find(e);
+		scatter(archetypes[location->archetype], location->slot, component);
+	}
+
+	// Add a component to an entity, moving it to another archetype
+	template <typename T>
+	void add(Entity e, const T& component)
+	{
+		assert(contains(e) && !has<T>(e));
+		Location* location = find(e);
+		Location& moved = migrate(e, archetypes[location->archetype].signature | signature_of<T>());
+		scatter(archetypes[moved.archetype], moved.slot, component);
+	}
+
+	// Remove a component from an entity, moving it to another archetype
+	template <typename T>
+	void remove(Entity e)
+	{
+		assert(has<T>(e));
+		Location* location = find(e);
+		migrate(e, archetypes[location->archetype].signature & ~signature_of<T>());
+	}
+
+	// Number of entities
+	size_t size() const
+	{
+		return entity_count;
+	}
+
+	// Remove all entities, the chunks are kept for re-use
+	void clear()
+	{
+		for (Archetype& archetype : archetypes)
+		{
+			for (Entity e : archetype.entities)
+				locations[e.index()].archetype = no_lane;
+			archetype.entities.clear();
+			archetype.size = 0;
+		}
+		entity_count = 0;
+	}
+
+	// Calls func(ChunkView&) for every non-empty chunk of all archetypes that contain all of 'T...'
+	// Note, don't create or destroy entities inside func
+	template <typename... T, typename Func>
+	void each_chunk(Func func)
+	{
+		Signature required = signature_of<T...>();
+		for (Archetype& archetype : archetypes)
+		{
+			if ((archetype.signature & required) != required)
+				continue;
+			for (unsigned int chunk = 0; chunk * chunk_capacity < archetype.size; chunk++)
+			{
+				ChunkView view;
+				view.count = std::min(chunk_capacity, archetype.size - chunk * chunk_capacity);
+				view.entities = archetype.entities.data() + chunk * chunk_capacity;
+				view.data = archetype.chunks[chunk].get();
+				view.lane_offsets = archetype.lane_offsets;
+				func(view);
+			}
+		}
+	}
+};
+
+template <typename... Component>
+const unsigned int ArchetypeRegistry<Component...>::chunk_capacity;
+template <typename... Component>
+const unsigned int ArchetypeRegistry<Component...>::no_lane;
+template <typename... Component>
+const unsigned int ArchetypeRegistry<Component...>::type_count;
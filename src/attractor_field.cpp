@@ -0,0 +1,195 @@
+// Header
+#include "attractor_field.hpp"
+
+// stlib
+#include <algorithm>
+
+const unsigned int AttractorField::leaf_size;
+const int AttractorField::max_depth;
+
+AttractorField::AttractorField(size_t tree_threshold, float theta, float max_error)
+	: tree_threshold(tree_threshold)
+	, theta(theta)
+	, max_error(max_error)
+{
+}
+
+void AttractorField::clear()
+{
+	attractors.clear();
+	nodes.clear();
+	radius_sums.clear();
+	by_radius.clear();
+}
+
+void AttractorField::add(vec2 position, float radius, float force)
+{
+	attractors.push_back({ position, radius, force });
+}
+
+// The pull of one attractor, written as PhysicsSystem::step always did it
+static void pull(vec2 position, vec2 attractor_position, float radius, float force, vec2& velocity)
+{
+	float dist = distance(position, attractor_position);
+	vec2 diff = position - attractor_position;
+	if (dist < radius)
+	{
+		// normalize the vector
+		diff = normalize(diff);
+		// scale the vector by the force
+		diff *= force;
+		velocity -= diff;
+	}
+}
+
+void AttractorField::build()
+{
+	nodes.clear();
+	radius_sums.clear();
+	by_radius.clear();
+	if (attractors.size() <= tree_threshold)
+		return;
+	nodes.push_back(Node());
+	nodes[0].end = (unsigned int)attractors.size();
+	split(0, 0);
+}
+
+void AttractorField::split(unsigned int index, int depth)
+{
+	// bounds of the attractors of the node, and their sums by decreasing radius
+	unsigned int begin = nodes[index].begin;
+	unsigned int end = nodes[index].end;
+	vec2 bounds_min = attractors[begin].position;
+	vec2 bounds_max = attractors[begin].position;
+	scratch.assign(attractors.begin() + begin, attractors.begin() + end);
+	for (const Source& source : scratch)
+	{
+		bounds_min = min(bounds_min, source.position);
+		bounds_max = max(bounds_max, source.position);
+	}
+	std::sort(scratch.begin(), scratch.end(), [](const Source& a, const Source& b) { return a.radius > b.radius; });
+	nodes[index].min = bounds_min;
+	nodes[index].max = bounds_max;
+	nodes[index].sums = (unsigned int)radius_sums.size();
+	RadiusSum sum = { 0.f, 0.f, { 0.f, 0.f } };
+	for (const Source& source : scratch)
+	{
+		sum.radius = source.radius;
+		radius_sums.push_back(sum);
+		by_radius.push_back(source);
+		sum.force += source.force;
+		sum.weighted_centre += source.position * source.force;
+	}
+	sum.radius = 0.f;
+	radius_sums.push_back(sum);
+	by_radius.push_back(Source()); // keeps the two arrays aligned
+
+	// attractors on the same spot can't be split
+	if (end - begin <= leaf_size || depth >= max_depth || bounds_min == bounds_max)
+		return;
+
+	// sort the attractors into the quadrants around the middle of the bounds
+	vec2 middle = (nodes[index].min + nodes[index].max) / 2.f;
+	unsigned int counts[4] = { 0, 0, 0, 0 };
+	for (unsigned int i = begin; i < end; i++)
+		counts[(attractors[i].position.x >= middle.x ? 1 : 0) + (attractors[i].position.y >= middle.y ? 2 : 0)]++;
+	unsigned int starts[4] = { begin, begin + counts[0], begin + counts[0] + counts[1], begin + counts[0] + counts[1] + counts[2] };
+	unsigned int fill[4] = { starts[0] - begin, starts[1] - begin, starts[2] - begin, starts[3] - begin };
+	scratch.resize(end - begin);
+	for (unsigned int i = begin; i < end; i++)
+		scratch[fill[(attractors[i].position.x >= middle.x ? 1 : 0) + (attractors[i].position.y >= middle.y ? 2 : 0)]++] = attractors[i];
+	std::copy(scratch.begin(), scratch.end(), attractors.begin() + begin);
+
+	// the children are added after the node, so references into 'nodes' don't survive this
+	unsigned int first_child = (unsigned int)nodes.size();
+	nodes.resize(nodes.size() + 4);
+	nodes[index].first_child = first_child;
+	for (unsigned int q = 0; q < 4; q++)
+	{
+		nodes[first_child + q].begin = starts[q];
+		nodes[first_child + q].end = starts[q] + counts[q];
+	}
+	for (unsigned int q = 0; q < 4; q++)
+		if (counts[q] > 0)
+			split(first_child + q, depth + 1);
+}
+
+unsigned int AttractorField::count_reaching(const Node& node, float distance) const
+{
+	// the radii decrease, find the first one that is not larger
+	unsigned int low = 0;
+	unsigned int high = node.end - node.begin;
+	while (low < high)
+	{
+		unsigned int k = (low + high) / 2;
+		if (radius_sums[node.sums + k].radius > distance)
+			low = k + 1;
+		else
+			high = k;
+	}
+	return low;
+}
+
+vec2 AttractorField::velocity_at(vec2 position) const
+{
+	vec2 velocity = { 0.f, 0.f };
+	if (nodes.empty())
+	{
+		for (const Source& source : attractors)
+			pull(position, source.position, source.radius, source.force, velocity);
+		return velocity;
+	}
+
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (node.begin == node.end)
+			continue;
+
+		// no attractor of the node reaches the position if the closest possible centre is out of reach
+		float nearest = distance(position, clamp(position, node.min, node.max));
+		if (nearest >= radius_sums[node.sums].radius)
+			continue;
+
+		// a node that is small compared to its distance from the position (not just from its middle, so
+		// positions inside or next to the bounds always refine) may pull as one, with those of its
+		// attractors that certainly reach the position: their radius is larger than the distance to the
+		// farthest possible centre. Those whose radius isn't larger than the distance to the closest
+		// possible centre certainly don't, and the few in between are tested one by one.
+		float size = std::max(node.max.x - node.min.x, node.max.y - node.min.y);
+		if (size < theta * nearest)
+		{
+			vec2 middle = (node.min + node.max) / 2.f;
+			vec2 corner = { position.x < middle.x ? node.max.x : node.min.x, position.y < middle.y ? node.max.y : node.min.y };
+			unsigned int reaching = count_reaching(node, distance(position, corner));
+			const RadiusSum& sum = radius_sums[node.sums + reaching];
+			// seen from the position, the directions to the attractors differ by at most diagonal / nearest
+			// from the direction to their centre, which bounds the error of pulling as one
+			if (sum.force * distance(node.min, node.max) <= max_error * nearest)
+			{
+				unsigned int maybe_reaching = count_reaching(node, nearest);
+				if (sum.force != 0.f)
+					velocity -= normalize(position - sum.weighted_centre / sum.force) * sum.force;
+				for (unsigned int k = reaching; k < maybe_reaching; k++)
+				{
+					const Source& source = by_radius[node.sums + k];
+					pull(position, source.position, source.radius, source.force, velocity);
+				}
+				continue;
+			}
+		}
+
+		if (node.first_child == 0)
+		{
+			for (unsigned int i = node.begin; i < node.end; i++)
+				pull(position, attractors[i].position, attractors[i].radius, attractors[i].force, velocity);
+			continue;
+		}
+		for (unsigned int q = 0; q < 4; q++)
+			stack.push_back(node.first_child + q);
+	}
+	return velocity;
+}
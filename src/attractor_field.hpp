@@ -0,0 +1,88 @@
+#pragma once
+
+// stlib
+#include <vector>
+
+#include "common.hpp"
+
+// The velocity that the attractors (whirlpools) add to everything around them. An attractor pulls
+// everything within its radius towards its centre with its force, regardless of the distance.
+// The field is rebuilt every step: add() all attractors, then build(), then ask velocity_at().
+// Up to 'tree_threshold' attractors are summed directly in the order they were added. Beyond that
+// they are put into a Barnes-Hut quadtree. Subtrees that can't reach a point are skipped. A subtree
+// that is small from a point (size / distance to its bounds < theta) pulls like a single attractor,
+// with the total force of its attractors that certainly reach the point at their force-weighted centre.
+// These are looked up in the subtree's attractors sorted by radius. The few whose reach can't be
+// decided from the bounds of the subtree are tested one by one, so only the directions are approximated.
+// A subtree only pulls as one if that moves its pull by at most 'max_error' (in force units, the
+// default is about the force of an average whirlpool), otherwise it is refined. Several subtrees can
+// be off at the same point, so this bounds the error per subtree and not per point.
+// The tree is not a win at the scale of a whirlpool storm: whirlpools reach across a good part of the
+// window, so few subtrees are far and small enough to pull as one, and the tree is about as fast as the
+// direct sum for a few hundred attractors. It only gets ahead in the thousands, and then not by much,
+// so the default threshold keeps the exact direct sum for anything the game spawns.
+class AttractorField
+{
+public:
+	explicit AttractorField(size_t tree_threshold = 1024, float theta = 0.5f, float max_error = 30.f);
+
+	void clear();
+
+	void add(vec2 position, float radius, float force);
+
+	// Call after the last add() and before the first velocity_at()
+	void build();
+
+	vec2 velocity_at(vec2 position) const;
+
+	size_t size() const { return attractors.size(); }
+	bool uses_tree() const { return !nodes.empty(); }
+
+private:
+	struct Source
+	{
+		vec2 position;
+		float radius;
+		float force;
+	};
+
+	struct Node
+	{
+		vec2 min; // bounds of the attractor centres in the node
+		vec2 max;
+		unsigned int first_child = 0; // of 4 consecutive nodes, 0 for leaves
+		unsigned int begin = 0; // range of 'attractors' in the node
+		unsigned int end = 0;
+		unsigned int sums = 0; // the first of the end - begin + 1 entries of 'radius_sums' of the node
+	};
+
+	// The attractors of a node by decreasing radius: the k-th entry of a node holds the k-th largest
+	// radius, and the sum of the forces and of the force-weighted centres of the k larger ones
+	struct RadiusSum
+	{
+		float radius;
+		float force;
+		vec2 weighted_centre;
+	};
+
+	// Attractors of a node are split until a leaf holds at most this many
+	static const unsigned int leaf_size = 8;
+	static const int max_depth = 16;
+
+	size_t tree_threshold;
+	float theta;
+	float max_error;
+	std::vector<Source> attractors; // grouped by leaf once the tree is built
+	std::vector<Node> nodes;
+	std::vector<RadiusSum> radius_sums;
+	std::vector<Source> by_radius; // the attractors of each node by decreasing radius, aligned with 'radius_sums'
+
+	std::vector<Source> scratch;
+	mutable std::vector<unsigned int> stack;
+
+	// Split node 'index' into quadrants, and those recursively
+	void split(unsigned int index, int depth);
+
+	// Number of attractors of a node with a radius larger than 'distance'
+	unsigned int count_reaching(const Node& node, float distance) const;
+};
@@ -40,22 +40,89 @@ struct BoundingBox {
 	vec2 pos = { 0.f, 0.f };
 };
 
+// One of the four tracker lines around a bounding box, the line is a child of the box's entity (see Relationship)
 struct BoundingLine {
 	BOUNDING_LINE_POS position = BOUNDING_LINE_POS::TOP;
-	Entity entity; // not passed by reference, so it's a copy
-	BoundingLine(BOUNDING_LINE_POS position, Entity& entity) : position(position), entity(entity) {};
+	BoundingLine(BOUNDING_LINE_POS position) : position(position) {};
 };
 
+// Links an entity into a hierarchy. The children of an entity are chained through next_sibling,
+// starting at first_child; Entity::null() ends the chain. Removing an entity also removes its children.
+// Use ECSRegistry::attach and ECSRegistry::detach to change the links.
+struct Relationship {
+	Entity parent = Entity::null();
+	Entity first_child = Entity::null();
+	Entity next_sibling = Entity::null();
+};
+
+// Relationships and bounding boxes are referenced while further ones are created (ECSRegistry::attach,
+// createTrackerLines), so they are stored in pages that don't move on insert
+template <> struct component_storage<Relationship> { typedef PagedVector<Relationship> type; };
+template <> struct component_storage<BoundingBox> { typedef PagedVector<BoundingBox> type; };
+
 struct PendingRemove {
 
 };
 
+// An entity that is recycled by an EntityPool, 'pool' identifies the pool. A parked entity has no
+// components besides this, its Relationship and the BoundingLines of its children, see EntityPool::park
+struct Pooled {
+	unsigned int pool = 0;
+	bool parked = false;
+};
+
+// Collision layers, which layers are tested against each other is set by the CollisionFilter
+enum class COLLISION_LAYER {
+	PLAYER = 0,
+	PREY = PLAYER + 1,
+	HAZARD = PREY + 1,
+	ATTRACTOR = HAZARD + 1,
+	DECORATION = ATTRACTOR + 1,
+	LAYER_COUNT = DECORATION + 1
+};
+const int collision_layer_count = (int)COLLISION_LAYER::LAYER_COUNT;
+
+// An Object that takes part in collision detection, objects without a Collider are never tested
+struct Collider
+{
+	COLLISION_LAYER layer = COLLISION_LAYER::DECORATION;
+};
+
+// The pairs of collision layers that are tested against each other, a registry context resource
+// (registry.ctx<CollisionFilter>()). PhysicsSystem drops all other pairs before the circle test, and
+// objects on a layer that collides with nothing don't even enter the broadphase.
+struct CollisionFilter
+{
+	unsigned int masks[collision_layer_count] = {}; // bit j of masks[i] is set if layers i and j collide
+
+	void enable(COLLISION_LAYER a, COLLISION_LAYER b)
+	{
+		masks[(int)a] |= 1u << (int)b;
+		masks[(int)b] |= 1u << (int)a;
+	}
+
+	bool collides(COLLISION_LAYER a, COLLISION_LAYER b) const
+	{
+		return (masks[(int)a] >> (int)b) & 1u;
+	}
+
+	// 0 if the layer collides with nothing
+	unsigned int mask_of(COLLISION_LAYER layer) const
+	{
+		return masks[(int)layer];
+	}
+};
+
 // Stucture to store collision information
 struct Collision
 {
 	// Note, the first object is stored in the ECS container.entities
 	Entity other; // the second object involved in the collision
-	Collision(Entity& other) { this->other = other; };
+	// the layers of the two objects when they collided, they select the handler in WorldSystem::handle_collisions
+	COLLISION_LAYER layer;
+	COLLISION_LAYER other_layer;
+	// copy-construct, a default constructed Entity would allocate a new id
+	Collision(Entity& other, COLLISION_LAYER layer, COLLISION_LAYER other_layer) : other(other), layer(layer), other_layer(other_layer) {};
 };
 
 // Data structure for toggling debug mode
@@ -65,12 +132,27 @@ struct Debug {
 };
 extern Debug debugging;
 
-// Sets the brightness of the screen
+// Sets the brightness of the screen, a registry context resource (registry.ctx<ScreenState>())
 struct ScreenState
 {
 	float darken_screen_factor = -1;
 };
 
+// Timing of the current frame, a registry context resource updated once per frame by the main loop
+struct FrameClock
+{
+	float elapsed_ms = 0.f; // duration of the current frame, scaled by the game speed
+	float total_ms = 0.f; // sum of all frame durations
+	unsigned int frame = 0; // number of the current frame
+
+	void tick(float ms)
+	{
+		elapsed_ms = ms;
+		total_ms += ms;
+		frame++;
+	}
+};
+
 // A struct to refer to debugging graphics in the ECS
 struct DebugComponent
 {
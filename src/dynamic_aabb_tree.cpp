@@ -0,0 +1,292 @@
+// Header
+#include "dynamic_aabb_tree.hpp"
+
+// stlib
+#include <algorithm>
+
+const int DynamicAabbTree::null_node;
+
+DynamicAabbTree::DynamicAabbTree(float margin)
+	: margin(margin)
+{
+}
+
+int DynamicAabbTree::allocate_node()
+{
+	if (free_list == null_node)
+	{
+		nodes.push_back(Node());
+		return (int)nodes.size() - 1;
+	}
+	int index = free_list;
+	free_list = nodes[index].parent;
+	nodes[index] = Node();
+	return index;
+}
+
+void DynamicAabbTree::free_node(int index)
+{
+	nodes[index].parent = free_list;
+	nodes[index].height = 0;
+	free_list = index;
+}
+
+int DynamicAabbTree::insert(const Aabb& box, unsigned int user_data)
+{
+	int proxy = allocate_node();
+	nodes[proxy].box = { box.min - vec2(margin), box.max + vec2(margin) };
+	nodes[proxy].user_data = user_data;
+	nodes[proxy].height = 1;
+	insert_leaf(proxy);
+	leaf_count++;
+	return proxy;
+}
+
+void DynamicAabbTree::remove(int proxy)
+{
+	assert(proxy >= 0 && proxy < (int)nodes.size() && nodes[proxy].is_leaf() && nodes[proxy].height == 1);
+	remove_leaf(proxy);
+	free_node(proxy);
+	leaf_count--;
+}
+
+bool DynamicAabbTree::move(int proxy, const Aabb& box)
+{
+	assert(proxy >= 0 && proxy < (int)nodes.size() && nodes[proxy].is_leaf() && nodes[proxy].height == 1);
+	if (contains(nodes[proxy].box, box))
+		return false;
+	remove_leaf(proxy);
+	nodes[proxy].box = { box.min - vec2(margin), box.max + vec2(margin) };
+	insert_leaf(proxy);
+	return true;
+}
+
+void DynamicAabbTree::clear()
+{
+	nodes.clear();
+	root = null_node;
+	free_list = null_node;
+	leaf_count = 0;
+}
+
+void DynamicAabbTree::insert_leaf(int leaf)
+{
+	if (root == null_node)
+	{
+		root = leaf;
+		nodes[root].parent = null_node;
+		return;
+	}
+
+	// find the best sibling: descend while that is cheaper than pairing the leaf with the whole subtree,
+	// where the cost of a box is its perimeter
+	Aabb leaf_box = nodes[leaf].box;
+	int index = root;
+	while (!nodes[index].is_leaf())
+	{
+		const Node& node = nodes[index];
+		float combined = perimeter(combine(node.box, leaf_box));
+		float cost = 2.f * combined;
+		// every ancestor of the new leaf grows
+		float inheritance_cost = 2.f * (combined - perimeter(node.box));
+
+		float child_costs[2];
+		int children[2] = { node.left, node.right };
+		for (int c = 0; c < 2; c++)
+		{
+			const Node& child = nodes[children[c]];
+			child_costs[c] = perimeter(combine(child.box, leaf_box)) + inheritance_cost;
+			if (!child.is_leaf())
+				child_costs[c] -= perimeter(child.box);
+		}
+		if (cost < child_costs[0] && cost < child_costs[1])
+			break;
+		index = child_costs[0] < child_costs[1] ? node.left : node.right;
+	}
+
+	// a new parent joins the sibling and the leaf
+	int sibling = index;
+	int old_parent = nodes[sibling].parent;
+	int new_parent = allocate_node();
+	nodes[new_parent].parent = old_parent;
+	nodes[new_parent].box = combine(leaf_box, nodes[sibling].box);
+	nodes[new_parent].height = nodes[sibling].height + 1;
+	nodes[new_parent].left = sibling;
+	nodes[new_parent].right = leaf;
+	if (old_parent == null_node)
+		root = new_parent;
+	else if (nodes[old_parent].left == sibling)
+		nodes[old_parent].left = new_parent;
+	else
+		nodes[old_parent].right = new_parent;
+	nodes[sibling].parent = new_parent;
+	nodes[leaf].parent = new_parent;
+
+	refit(new_parent);
+}
+
+void DynamicAabbTree::remove_leaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = null_node;
+		return;
+	}
+
+	// the sibling takes the place of the parent
+	int parent = nodes[leaf].parent;
+	int grand_parent = nodes[parent].parent;
+	int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+	nodes[sibling].parent = grand_parent;
+	free_node(parent);
+	if (grand_parent == null_node)
+	{
+		root = sibling;
+		return;
+	}
+	if (nodes[grand_parent].left == parent)
+		nodes[grand_parent].left = sibling;
+	else
+		nodes[grand_parent].right = sibling;
+	refit(grand_parent);
+}
+
+void DynamicAabbTree::refit(int index)
+{
+	while (index != null_node)
+	{
+		index = balance(index);
+		Node& node = nodes[index];
+		node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+		node.box = combine(nodes[node.left].box, nodes[node.right].box);
+		index = node.parent;
+	}
+}
+
+int DynamicAabbTree::balance(int a)
+{
+	Node& A = nodes[a];
+	if (A.is_leaf() || A.height < 2)
+		return a;
+
+	int b = A.left;
+	int c = A.right;
+	int difference = nodes[c].height - nodes[b].height;
+	if (difference >= -1 && difference <= 1)
+		return a;
+
+	// the higher child 'up' takes the place of A, A keeps its lower child and the lower grandchild
+	// of 'up', 'up' keeps its higher child
+	bool right_heavy = difference > 1;
+	int up = right_heavy ? c : b;
+	int other = right_heavy ? b : c;
+	Node& U = nodes[up];
+	int f = U.left;
+	int g = U.right;
+	int higher = nodes[f].height > nodes[g].height ? f : g;
+	int lower = higher == f ? g : f;
+
+	U.left = a;
+	U.parent = A.parent;
+	A.parent = up;
+	if (U.parent == null_node)
+		root = up;
+	else if (nodes[U.parent].left == a)
+		nodes[U.parent].left = up;
+	else
+		nodes[U.parent].right = up;
+
+	U.right = higher;
+	if (right_heavy)
+		A.right = lower;
+	else
+		A.left = lower;
+	nodes[lower].parent = a;
+
+	A.box = combine(nodes[other].box, nodes[lower].box);
+	A.height = 1 + std::max(nodes[other].height, nodes[lower].height);
+	U.box = combine(A.box, nodes[higher].box);
+	U.height = 1 + std::max(A.height, nodes[higher].height);
+	return up;
+}
+
+bool DynamicAabbTree::segment_hits(const Aabb& box, vec2 from, vec2 direction)
+{
+	float t_min = 0.f;
+	float t_max = 1.f;
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if (fabsf(direction[axis]) < 1e-12f)
+		{
+			if (from[axis] < box.min[axis] || from[axis] > box.max[axis])
+				return false;
+			continue;
+		}
+		float inverse = 1.f / direction[axis];
+		float t0 = (box.min[axis] - from[axis]) * inverse;
+		float t1 = (box.max[axis] - from[axis]) * inverse;
+		if (t0 > t1)
+			std::swap(t0, t1);
+		t_min = std::max(t_min, t0);
+		t_max = std::min(t_max, t1);
+		if (t_min > t_max)
+			return false;
+	}
+	return true;
+}
+
+void AabbTreeBroadphase::find_pairs(const Object* objects, const Entity* entities, size_t count, std::vector<ObjectPair>& pairs)
+{
+	stamp++;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float radius = broadphase_radius(objects[i]);
+		Aabb box = { objects[i].position - vec2(radius), objects[i].position + vec2(radius) };
+
+		Entity entity = entities[i];
+		if (entity.index() >= proxies.size())
+			proxies.resize(entity.index() + 1);
+		Proxy& proxy = proxies[entity.index()];
+		// the slot may have been re-used by a new entity since the last step
+		if (proxy.node != DynamicAabbTree::null_node && proxy.entity != entity)
+		{
+			tree.remove(proxy.node);
+			proxy.node = DynamicAabbTree::null_node;
+		}
+		if (proxy.node == DynamicAabbTree::null_node)
+		{
+			proxy.node = tree.insert(box, entity.index());
+			proxy.entity = entity;
+		}
+		else
+			tree.move(proxy.node, box);
+		proxy.position = i;
+		proxy.stamp = stamp;
+	}
+
+	// entities whose Object is gone
+	for (Proxy& proxy : proxies)
+	{
+		if (proxy.node != DynamicAabbTree::null_node && proxy.stamp != stamp)
+		{
+			tree.remove(proxy.node);
+			proxy.node = DynamicAabbTree::null_node;
+		}
+	}
+
+	// the fat boxes contain the exact ones, so every pair of overlapping objects is among the overlapping proxies
+	keys.clear();
+	tree.each_overlapping_pair([&](int a, int b) {
+		unsigned int i = proxies[tree.get_user_data(a)].position;
+		unsigned int j = proxies[tree.get_user_data(b)].position;
+		keys.push_back(i < j ? ((uint64_t)i << 32) | j : ((uint64_t)j << 32) | i);
+	});
+
+	std::sort(keys.begin(), keys.end());
+	pairs.resize(keys.size());
+	for (size_t k = 0; k < keys.size(); k++)
+	{
+		pairs[k].first = (unsigned int)(keys[k] >> 32);
+		pairs[k].second = (unsigned int)keys[k];
+	}
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+// stlib
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "common.hpp"
+#include "tiny_ecs.hpp"
+#include "spatial_hash_grid.hpp"
+
+// Axis aligned box given by its corners
+struct Aabb
+{
+	vec2 min;
+	vec2 max;
+};
+
+inline bool overlaps(const Aabb& a, const Aabb& b)
+{
+	return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y;
+}
+
+inline bool contains(const Aabb& outer, const Aabb& inner)
+{
+	return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && inner.max.x <= outer.max.x && inner.max.y <= outer.max.y;
+}
+
+inline Aabb combine(const Aabb& a, const Aabb& b)
+{
+	return { min(a.min, b.min), max(a.max, b.max) };
+}
+
+inline float perimeter(const Aabb& box)
+{
+	return 2.f * ((box.max.x - box.min.x) + (box.max.y - box.min.y));
+}
+
+// A bounding volume hierarchy over boxes that move every frame. Every box (a proxy) is stored
+// enlarged by a margin, so small movements don't change the tree at all, and larger ones
+// re-insert only that leaf. Rotations keep the tree balanced, so boxes of very different sizes
+// (whirlpools next to fish and thin tracker lines) don't degrade it the way they do a fixed grid.
+class DynamicAabbTree
+{
+public:
+	static const int null_node = -1;
+
+	explicit DynamicAabbTree(float margin = 8.f);
+
+	// Add a box, returns the proxy that identifies it
+	int insert(const Aabb& box, unsigned int user_data);
+
+	void remove(int proxy);
+
+	// Update the box of a proxy, returns true if the proxy had to be re-inserted
+	bool move(int proxy, const Aabb& box);
+
+	void clear();
+
+	unsigned int get_user_data(int proxy) const { return nodes[proxy].user_data; }
+
+	// The enlarged box stored for a proxy
+	const Aabb& get_fat_box(int proxy) const { return nodes[proxy].box; }
+
+	size_t proxy_count() const { return leaf_count; }
+
+	// 0 for an empty tree, 1 for a single leaf
+	int height() const { return root == null_node ? 0 : nodes[root].height; }
+
+	// Calls func(proxy) for every proxy whose fat box overlaps 'box', until func returns false
+	template <typename Func>
+	void query(const Aabb& box, Func func) const
+	{
+		if (root == null_node)
+			return;
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			int index = stack.back();
+			stack.pop_back();
+			const Node& node = nodes[index];
+			if (!overlaps(node.box, box))
+				continue;
+			if (node.is_leaf())
+			{
+				if (!func(index))
+					return;
+			}
+			else
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+	}
+
+	// Calls func(proxy_a, proxy_b) once for every two proxies whose fat boxes overlap. Instead of one
+	// query per proxy this descends the tree against itself, so every subtree pair is looked at once.
+	template <typename Func>
+	void each_overlapping_pair(Func func) const
+	{
+		if (root == null_node || nodes[root].is_leaf())
+			return;
+		pair_stack.clear();
+		pair_stack.push_back({ root, root });
+		while (!pair_stack.empty())
+		{
+			int a = pair_stack.back().first;
+			int b = pair_stack.back().second;
+			pair_stack.pop_back();
+			const Node& A = nodes[a];
+			const Node& B = nodes[b];
+			if (a == b)
+			{
+				// the pairs within a subtree are those within either child and those across them
+				if (A.is_leaf())
+					continue;
+				pair_stack.push_back({ A.left, A.left });
+				pair_stack.push_back({ A.right, A.right });
+				pair_stack.push_back({ A.left, A.right });
+				continue;
+			}
+			if (!overlaps(A.box, B.box))
+				continue;
+			if (A.is_leaf() && B.is_leaf())
+				func(a, b);
+			// descend into the larger box
+			else if (B.is_leaf() || (!A.is_leaf() && perimeter(A.box) >= perimeter(B.box)))
+			{
+				pair_stack.push_back({ A.left, b });
+				pair_stack.push_back({ A.right, b });
+			}
+			else
+			{
+				pair_stack.push_back({ a, B.left });
+				pair_stack.push_back({ a, B.right });
+			}
+		}
+	}
+
+	// Calls func(proxy) for every proxy whose fat box is hit by the segment from 'from' to 'to',
+	// until func returns false. The proxies are not visited in the order of the hits.
+	template <typename Func>
+	void ray_cast(vec2 from, vec2 to, Func func) const
+	{
+		if (root == null_node)
+			return;
+		vec2 direction = to - from;
+		Aabb segment_box = { min(from, to), max(from, to) };
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			int index = stack.back();
+			stack.pop_back();
+			const Node& node = nodes[index];
+			if (!overlaps(node.box, segment_box) || !segment_hits(node.box, from, direction))
+				continue;
+			if (node.is_leaf())
+			{
+				if (!func(index))
+					return;
+			}
+			else
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+	}
+
+private:
+	struct Node
+	{
+		Aabb box;
+		int parent = null_node; // the next free node while the node is unused
+		int left = null_node;
+		int right = null_node;
+		int height = 0; // 1 for leaves, 0 for free nodes
+		unsigned int user_data = 0;
+
+		bool is_leaf() const { return left == null_node; }
+	};
+
+	std::vector<Node> nodes;
+	int root = null_node;
+	int free_list = null_node;
+	size_t leaf_count = 0;
+	float margin;
+
+	// traversal stacks, kept to re-use their memory
+	mutable std::vector<int> stack;
+	mutable std::vector<std::pair<int, int>> pair_stack;
+
+	int allocate_node();
+	void free_node(int index);
+	void insert_leaf(int leaf);
+	void remove_leaf(int leaf);
+	// Rotate the subtree at 'index' if its children differ in height by more than one, returns its new root
+	int balance(int index);
+	// Recompute the boxes and heights from 'index' up to the root, balancing on the way
+	void refit(int index);
+
+	// Slab test of the segment from + t * direction, 0 <= t <= 1, against a box
+	static bool segment_hits(const Aabb& box, vec2 from, vec2 direction);
+};
+
+// Broadphase for the circle test of PhysicsSystem built on a DynamicAabbTree, an alternative to
+// SpatialHashGrid with the same output. Unlike the grid it persists across steps: every entity with an
+// Object keeps a proxy for the square around its bounding circle (which contains its BoundingBox),
+// only proxies of objects that moved out of their fat box are re-inserted.
+class AabbTreeBroadphase
+{
+public:
+	// All pairs of objects whose bounding circles may overlap, sorted by (first, second) and without
+	// duplicates, see SpatialHashGrid::find_pairs. 'entities' are the owners of the objects, they
+	// identify the proxies from one step to the next.
+	void find_pairs(const Object* objects, const Entity* entities, size_t count, std::vector<ObjectPair>& pairs);
+
+	// The tree, e.g., for region and ray queries. The user data of a proxy is the Entity::index() of its owner.
+	const DynamicAabbTree& get_tree() const { return tree; }
+
+private:
+	struct Proxy
+	{
+		Entity entity = Entity::null();
+		int node = DynamicAabbTree::null_node;
+		unsigned int position = 0; // of the object in the last find_pairs
+		unsigned int stamp = 0; // find_pairs call that last saw the object
+	};
+
+	DynamicAabbTree tree;
+	std::vector<Proxy> proxies; // indexed by Entity::index()
+	std::vector<uint64_t> keys;
+	unsigned int stamp = 0;
+};
@@ -0,0 +1,56 @@
+// Header
+#include "entity_pool.hpp"
+#include "tiny_ecs_registry.hpp"
+#include "world_init.hpp"
+
+EntityPool::EntityPool(unsigned int id, const Prefab* prefab)
+	: id(id)
+	, prefab(prefab)
+{
+}
+
+Entity EntityPool::spawn(RenderSystem* renderer, const PrefabOverrides& overrides)
+{
+	if (parked.empty())
+	{
+		misses++;
+		Entity entity = instantiate(renderer, *prefab, overrides);
+		registry.pooled.emplace(entity).pool = id;
+		return entity;
+	}
+
+	hits++;
+	Entity entity = parked.back();
+	parked.pop_back();
+	assign_prefab(renderer, entity, *prefab, overrides);
+	if (prefab->tracker_lines)
+		restoreTrackerLines(entity);
+	registry.pooled.get(entity).parked = false;
+	return entity;
+}
+
+void EntityPool::park(Entity e)
+{
+	assert(registry.pooled.has(e) && registry.pooled.read(e).pool == id);
+	// the structure of the entity survives, everything the systems look at is removed
+	Signature removed = ~registry.mask<Pooled, Relationship, BoundingLine>();
+	registry.remove_components(e, removed);
+	if (registry.relationships.has(e))
+	{
+		for (Entity child = registry.relationships.read(e).first_child; child != Entity::null(); child = registry.relationships.read(child).next_sibling)
+			registry.remove_components(child, removed);
+	}
+	registry.pooled.get(e).parked = true;
+	parked.push_back(e);
+}
+
+void EntityPool::rebuild()
+{
+	parked.clear();
+	for (size_t i = 0; i < registry.pooled.size(); i++)
+	{
+		const Pooled& pooled = registry.pooled.components[i];
+		if (pooled.pool == id && pooled.parked)
+			parked.push_back(registry.pooled.entities[i]);
+	}
+}
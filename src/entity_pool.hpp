@@ -0,0 +1,37 @@
+#pragma once
+
+// stlib
+#include <vector>
+
+#include "prefab.hpp"
+
+// Recycles the entities of one prefab. Instead of being destroyed, an entity is parked: it loses
+// the components that systems iterate, but keeps its id, its Relationship to its tracker lines and
+// the container memory of its components. spawn() re-uses a parked entity if there is one, so in the
+// steady state spawning and despawning allocate nothing.
+class EntityPool
+{
+	unsigned int id;
+	const Prefab* prefab;
+	std::vector<Entity> parked;
+
+public:
+	// spawns that re-used a parked entity, and those that had to create a new one
+	size_t hits = 0;
+	size_t misses = 0;
+
+	EntityPool(unsigned int id, const Prefab* prefab);
+
+	// A prefab instance, either a re-used parked entity or a new one
+	Entity spawn(RenderSystem* renderer, const PrefabOverrides& overrides);
+
+	// Take an entity of this pool out of the game until the next spawn()
+	// Note, this must not be called while iterating over containers
+	void park(Entity e);
+
+	// Collect the parked entities of this pool again, e.g., after a registry snapshot was loaded
+	void rebuild();
+
+	const Prefab& get_prefab() const { return *prefab; }
+	size_t parked_count() const { return parked.size(); }
+};
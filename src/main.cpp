@@ -45,9 +45,12 @@ int main()
 			(float)(std::chrono::duration_cast<std::chrono::microseconds>(now - t)).count() / 1000;
 		t = now;
 		elapsed_ms = elapsed_ms * world.get_current_speed();
+		registry.ctx<FrameClock>().tick(elapsed_ms);
 		world.step(elapsed_ms);
+		registry.flush(); // apply the removals and component changes recorded during the step
 		physics.step(elapsed_ms);
 		world.handle_collisions();
+		registry.flush();
 
 		renderer.draw();
 	}
@@ -0,0 +1,226 @@
+// Header
+#include "narrowphase.hpp"
+
+// stlib
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+// The SSE and AVX kernels are compiled for their instruction set on their own (target attributes on
+// GCC and Clang, MSVC accepts the intrinsics anywhere), so the rest of the game doesn't need AVX to run
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NARROWPHASE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define NARROWPHASE_TARGET_SSE
+#define NARROWPHASE_TARGET_AVX
+#else
+#define NARROWPHASE_TARGET_SSE __attribute__((target("sse2")))
+#define NARROWPHASE_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+static NarrowphaseKernel detect_kernel()
+{
+#if defined(NARROWPHASE_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool sse2 = (info[3] >> 26) & 1;
+	// AVX also needs the OS to save the ymm registers
+	bool avx = ((info[2] >> 28) & 1) && ((info[2] >> 27) & 1) && (_xgetbv(0) & 6) == 6;
+	if (avx)
+		return NarrowphaseKernel::AVX;
+	if (sse2)
+		return NarrowphaseKernel::SSE;
+#elif defined(NARROWPHASE_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx"))
+		return NarrowphaseKernel::AVX;
+	if (__builtin_cpu_supports("sse2"))
+		return NarrowphaseKernel::SSE;
+#endif
+	return NarrowphaseKernel::SCALAR;
+}
+
+NarrowphaseKernel widest_narrowphase_kernel()
+{
+	static const NarrowphaseKernel widest = detect_kernel();
+	return widest;
+}
+
+static NarrowphaseKernel calibrate_kernel()
+{
+	NarrowphaseKernel widest = widest_narrowphase_kernel();
+	if (widest == NarrowphaseKernel::SCALAR)
+		return widest;
+
+	// fish and tracker line sized circles at the density of the game, with the candidate pairs of the
+	// grid: neighbours on the arrays and about one pair in twelve hits, random pairs would hit far less
+	const size_t object_count = 8192;
+	const float side = sqrtf(1200.f * 800.f / 100.f * object_count);
+	std::default_random_engine rng(427);
+	std::uniform_real_distribution<float> uniform_dist;
+	std::vector<Object> objects(object_count);
+	CircleColliders circles;
+	for (Object& object : objects)
+	{
+		object.position = { side * uniform_dist(rng), side * uniform_dist(rng) };
+		object.scale = uniform_dist(rng) < 0.2f ? vec2(99.f, 99.f) : vec2(99.f, 10.f);
+		float radius = length(object.scale) / 2.f;
+		circles.push_back(object.position, radius * radius);
+	}
+	std::vector<ObjectPair> pairs;
+	SpatialHashGrid().find_pairs(objects.data(), objects.size(), pairs);
+	std::vector<ObjectPair> hits;
+	hits.reserve(pairs.size());
+
+	// the kernels take turns, so a slow moment of the machine doesn't hit a single one
+	typedef std::chrono::high_resolution_clock Clock;
+	double best_ns[(int)NarrowphaseKernel::KERNEL_COUNT];
+	std::fill(best_ns, best_ns + (int)NarrowphaseKernel::KERNEL_COUNT, 1e300);
+	for (int round = 0; round < 7; round++)
+		for (int k = 0; k <= (int)widest; k++)
+		{
+			hits.clear();
+			auto t = Clock::now();
+			find_hits(circles, pairs.data(), pairs.size(), hits, (NarrowphaseKernel)k);
+			best_ns[k] = std::min(best_ns[k], std::chrono::duration<double, std::nano>(Clock::now() - t).count());
+		}
+
+	// on a tie the narrower kernel wins
+	int best = 0;
+	for (int k = 1; k <= (int)widest; k++)
+		if (best_ns[k] < best_ns[best])
+			best = k;
+	return (NarrowphaseKernel)best;
+}
+
+NarrowphaseKernel best_narrowphase_kernel()
+{
+	static const NarrowphaseKernel best = calibrate_kernel();
+	return best;
+}
+
+const char* narrowphase_kernel_name(NarrowphaseKernel kernel)
+{
+	static const char* names[(int)NarrowphaseKernel::KERNEL_COUNT] = { "scalar", "sse", "avx" };
+	return names[(int)kernel];
+}
+
+// The kernels write every tested pair to 'hits' at position 'hit_count' and only advance the count for
+// hits, instead of branching on every test. A fraction of the pairs hits at random, so the branch
+// would be mispredicted all the time.
+
+// Test pairs [begin, end) one at a time, written like collides(), returns the new hit count
+static size_t find_hits_scalar(const CircleColliders& circles, const ObjectPair* pairs, size_t begin, size_t end, ObjectPair* hits, size_t hit_count)
+{
+	const float* x = circles.x.data();
+	const float* y = circles.y.data();
+	const float* radius_squared = circles.radius_squared.data();
+	for (size_t k = begin; k < end; k++)
+	{
+		unsigned int i = pairs[k].first;
+		unsigned int j = pairs[k].second;
+		float dx = x[i] - x[j];
+		float dy = y[i] - y[j];
+		float dist_squared = dx * dx + dy * dy;
+		hits[hit_count] = pairs[k];
+		hit_count += dist_squared < max(radius_squared[i], radius_squared[j]) ? 1 : 0;
+	}
+	return hit_count;
+}
+
+#if defined(NARROWPHASE_X86)
+
+// Append the pairs of a block of 'lanes' pairs whose bit is set in 'mask', lowest bit first
+static size_t append_hits(const ObjectPair* block, int lanes, int mask, ObjectPair* hits, size_t hit_count)
+{
+	for (int lane = 0; lane < lanes; lane++)
+	{
+		hits[hit_count] = block[lane];
+		hit_count += (mask >> lane) & 1;
+	}
+	return hit_count;
+}
+
+NARROWPHASE_TARGET_SSE
+static size_t find_hits_sse(const CircleColliders& circles, const ObjectPair* pairs, size_t& k, size_t count, ObjectPair* hits, size_t hit_count)
+{
+	const float* x = circles.x.data();
+	const float* y = circles.y.data();
+	const float* radius_squared = circles.radius_squared.data();
+	for (; k + 4 <= count; k += 4)
+	{
+		const ObjectPair* p = pairs + k;
+		// the pairs are scattered over the arrays, so each lane is loaded on its own
+		__m128 dx = _mm_sub_ps(
+			_mm_setr_ps(x[p[0].first], x[p[1].first], x[p[2].first], x[p[3].first]),
+			_mm_setr_ps(x[p[0].second], x[p[1].second], x[p[2].second], x[p[3].second]));
+		__m128 dy = _mm_sub_ps(
+			_mm_setr_ps(y[p[0].first], y[p[1].first], y[p[2].first], y[p[3].first]),
+			_mm_setr_ps(y[p[0].second], y[p[1].second], y[p[2].second], y[p[3].second]));
+		__m128 r_squared = _mm_max_ps(
+			_mm_setr_ps(radius_squared[p[0].first], radius_squared[p[1].first], radius_squared[p[2].first], radius_squared[p[3].first]),
+			_mm_setr_ps(radius_squared[p[0].second], radius_squared[p[1].second], radius_squared[p[2].second], radius_squared[p[3].second]));
+		__m128 dist_squared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		int mask = _mm_movemask_ps(_mm_cmplt_ps(dist_squared, r_squared));
+		hit_count = append_hits(p, 4, mask, hits, hit_count);
+	}
+	return hit_count;
+}
+
+NARROWPHASE_TARGET_AVX
+static size_t find_hits_avx(const CircleColliders& circles, const ObjectPair* pairs, size_t& k, size_t count, ObjectPair* hits, size_t hit_count)
+{
+	const float* x = circles.x.data();
+	const float* y = circles.y.data();
+	const float* radius_squared = circles.radius_squared.data();
+	for (; k + 8 <= count; k += 8)
+	{
+		const ObjectPair* p = pairs + k;
+		__m256 dx = _mm256_sub_ps(
+			_mm256_setr_ps(x[p[0].first], x[p[1].first], x[p[2].first], x[p[3].first],
+				x[p[4].first], x[p[5].first], x[p[6].first], x[p[7].first]),
+			_mm256_setr_ps(x[p[0].second], x[p[1].second], x[p[2].second], x[p[3].second],
+				x[p[4].second], x[p[5].second], x[p[6].second], x[p[7].second]));
+		__m256 dy = _mm256_sub_ps(
+			_mm256_setr_ps(y[p[0].first], y[p[1].first], y[p[2].first], y[p[3].first],
+				y[p[4].first], y[p[5].first], y[p[6].first], y[p[7].first]),
+			_mm256_setr_ps(y[p[0].second], y[p[1].second], y[p[2].second], y[p[3].second],
+				y[p[4].second], y[p[5].second], y[p[6].second], y[p[7].second]));
+		__m256 r_squared = _mm256_max_ps(
+			_mm256_setr_ps(radius_squared[p[0].first], radius_squared[p[1].first], radius_squared[p[2].first], radius_squared[p[3].first],
+				radius_squared[p[4].first], radius_squared[p[5].first], radius_squared[p[6].first], radius_squared[p[7].first]),
+			_mm256_setr_ps(radius_squared[p[0].second], radius_squared[p[1].second], radius_squared[p[2].second], radius_squared[p[3].second],
+				radius_squared[p[4].second], radius_squared[p[5].second], radius_squared[p[6].second], radius_squared[p[7].second]));
+		// no FMA, the rounding of the separate multiply and add is what collides() does
+		__m256 dist_squared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		int mask = _mm256_movemask_ps(_mm256_cmp_ps(dist_squared, r_squared, _CMP_LT_OQ));
+		hit_count = append_hits(p, 8, mask, hits, hit_count);
+	}
+	return hit_count;
+}
+
+#endif
+
+void find_hits(const CircleColliders& circles, const ObjectPair* pairs, size_t count, std::vector<ObjectPair>& hits, NarrowphaseKernel kernel)
+{
+	if (kernel > widest_narrowphase_kernel())
+		kernel = NarrowphaseKernel::SCALAR;
+
+	// room for every pair to hit, trimmed to the actual hits at the end
+	size_t hit_count = hits.size();
+	hits.resize(hit_count + count);
+
+	// the wide kernels leave the last few pairs to the scalar loop
+	size_t k = 0;
+#if defined(NARROWPHASE_X86)
+	if (kernel == NarrowphaseKernel::AVX)
+		hit_count = find_hits_avx(circles, pairs, k, count, hits.data(), hit_count);
+	else if (kernel == NarrowphaseKernel::SSE)
+		hit_count = find_hits_sse(circles, pairs, k, count, hits.data(), hit_count);
+#endif
+	hit_count = find_hits_scalar(circles, pairs, k, count, hits.data(), hit_count);
+	hits.resize(hit_count);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+// stlib
+#include <vector>
+
+#include "common.hpp"
+#include "spatial_hash_grid.hpp"
+
+// The circles of the circle test of PhysicsSystem (see collides) in structure of arrays form: the
+// centre and the squared radius of every collider, computed once per step instead of once per pair
+struct CircleColliders
+{
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> radius_squared;
+
+	void clear()
+	{
+		x.clear();
+		y.clear();
+		radius_squared.clear();
+	}
+
+	void push_back(vec2 centre, float r_squared)
+	{
+		x.push_back(centre.x);
+		y.push_back(centre.y);
+		radius_squared.push_back(r_squared);
+	}
+
+	size_t size() const { return x.size(); }
+};
+
+// Implementations of the narrowphase, all give exactly the same hits
+enum class NarrowphaseKernel {
+	SCALAR = 0,
+	SSE = SCALAR + 1, // 4 pairs at a time
+	AVX = SSE + 1, // 8 pairs at a time
+	KERNEL_COUNT = AVX + 1
+};
+
+// The widest kernel this CPU supports, detected on the first call
+NarrowphaseKernel widest_narrowphase_kernel();
+
+// The fastest kernel on this CPU, measured once on the first call. Each supported kernel runs a few
+// times on the grid pairs of a generated scene at the density of the game, and the fastest one wins. A wider
+// kernel is not faster by itself, the lanes are gathered one by one, so the width doesn't decide.
+NarrowphaseKernel best_narrowphase_kernel();
+
+const char* narrowphase_kernel_name(NarrowphaseKernel kernel);
+
+// Appends the candidate pairs whose circles overlap to 'hits', in the order of 'pairs'. A pair hits if
+// the distance of the centres is less than the larger of the two radii, the same float operations as
+// collides(), so the result is bit-identical. Kernels the CPU doesn't support fall back to SCALAR.
+void find_hits(const CircleColliders& circles, const ObjectPair* pairs, size_t count, std::vector<ObjectPair>& hits,
+	NarrowphaseKernel kernel = best_narrowphase_kernel());
@@ -2,6 +2,9 @@
 #include "physics_system.hpp"
 #include "world_init.hpp"
 
+// stlib
+#include <algorithm>
+
 // Returns the local bounding coordinates scaled by the current size of the entity
 vec2 get_bounding_box(const Object& object)
 {
@@ -9,6 +12,12 @@ vec2 get_bounding_box(const Object& object)
 	return { abs(object.scale.x), abs(object.scale.y) };
 }
 
+float collision_radius_squared(const Object& object)
+{
+	const vec2 bonding_box = get_bounding_box(object) / 2.f;
+	return dot(bonding_box, bonding_box);
+}
+
 // This is a SUPER APPROXIMATE check that puts a circle around the bounding boxes and sees
 // if the center point of either object is inside the other's bounding-box-circle. You can
 // surely implement a more accurate detection
@@ -16,115 +25,173 @@ bool collides(const Object& object1, const Object& object2)
 {
 	vec2 dp = object1.position - object2.position;
 	float dist_squared = dot(dp,dp);
-	const vec2 other_bonding_box = get_bounding_box(object1) / 2.f;
-	const float other_r_squared = dot(other_bonding_box, other_bonding_box);
-	const vec2 my_bonding_box = get_bounding_box(object2) / 2.f;
-	const float my_r_squared = dot(my_bonding_box, my_bonding_box);
+	const float other_r_squared = collision_radius_squared(object1);
+	const float my_r_squared = collision_radius_squared(object2);
 	const float r_squared = max(other_r_squared, my_r_squared);
 	if (dist_squared < r_squared)
 		return true;
 	return false;
 }
 
+PhysicsSystem::PhysicsSystem()
+{
+	// attractors that exist already, e.g., of another system's world
+	for (Entity e : registry.attractors.entities)
+		add_attractor(e);
+	attractor_construct_listener = registry.attractors.on_construct.connect([this](Entity e) { add_attractor(e); });
+	attractor_destroy_listener = registry.attractors.on_destroy.connect([this](Entity e) { remove_attractor(e); });
+}
+
+PhysicsSystem::~PhysicsSystem()
+{
+	registry.attractors.on_construct.disconnect(attractor_construct_listener);
+	registry.attractors.on_destroy.disconnect(attractor_destroy_listener);
+}
+
+void PhysicsSystem::add_attractor(Entity e)
+{
+	if (e.index() >= attractor_positions.size())
+		attractor_positions.resize(e.index() + 1);
+	attractor_positions[e.index()] = (unsigned int)attractor_entities.size();
+	attractor_entities.push_back(e);
+}
+
+void PhysicsSystem::remove_attractor(Entity e)
+{
+	// swap with the last one, like the containers do
+	unsigned int position = attractor_positions[e.index()];
+	Entity last = attractor_entities.back();
+	attractor_entities[position] = last;
+	attractor_positions[last.index()] = position;
+	attractor_entities.pop_back();
+}
+
+bool PhysicsSystem::attractor_index_matches_scan()
+{
+	if (attractor_entities.size() != registry.attractors.size())
+		return false;
+	for (Entity e : registry.attractors.entities)
+	{
+		unsigned int position = e.index() < attractor_positions.size() ? attractor_positions[e.index()] : ~0u;
+		if (position >= attractor_entities.size() || attractor_entities[position] != e)
+			return false;
+	}
+	return true;
+}
+
 void PhysicsSystem::step(float elapsed_ms)
 {
 	// Move fish based on how much time has passed, this is to (partially) avoid
 	// having entities move at different speed based on the machine.
-	auto& motion_registry = registry.motions;
-	auto& object_registry = registry.objects;
-	for(uint i = 0; i< motion_registry.size(); i++)
+	float step_seconds = elapsed_ms / 1000.f;
+
+	// spin every attractor once per step, and gather them for the force pass
+	assert(attractor_index_matches_scan() && "The attractor index is out of sync with registry.attractors");
+	attractor_field.clear();
+	for (Entity attractor : attractor_entities)
 	{
-		// !!! TODO A1: update motion.position based on step_seconds and motion.velocity
-		//Motion& motion = motion_registry.components[i];
-		// need to update position according to angle. 
-		Entity entity = motion_registry.entities[i];
-		Motion& motion = motion_registry.get(entity);
-		Object& object = object_registry.get(entity);
-		float step_seconds = elapsed_ms / 1000.f;
-
-		// calculate input velocity (input from controls or set input for entities)
-		Transform transform;
-		transform.rotate(object.angle);
-
-		// calculate external velocity (from attractors)
-		vec2 external_velocity = { 0.f, 0.f };
-		if (registry.attractors.size() > 0) {
-			if (!registry.attractors.has(entity)) {
-				for (Entity attractor : registry.attractors.entities) {
-					Attractor& attractor_attract = registry.attractors.get(attractor);
-					Motion& attractor_motion = motion_registry.get(attractor);
-					Object& attractor_object = object_registry.get(attractor);
-					attractor_object.angle += 0.0001f*elapsed_ms;
-					if (attractor_object.angle >= 360.f) {
-						attractor_object.angle -= 360.f;
-					}
-					float dist = distance(object.position, attractor_object.position);
-					vec2 diff = object.position - attractor_object.position;
-					if (dist < attractor_attract.radius)
-					{
-						// normalize the vector
-						diff = normalize(diff);
-						// scale the vector by the force
-						diff *= attractor_attract.force;
-						external_velocity -= diff;
-					}
-				}
-			}
-		} 
-		motion.external_velocity = external_velocity;
-
-
-
-		if (!registry.players.has(entity) && !registry.attractors.has(entity)) {
-			float acceleration_magnitude = length(motion.acceleration);
-
-			// Determine the sign of the starting acceleration
-
-			// Adjust the perpendicular acceleration vector based on the sign
-			vec2 perpendicular_acceleration = motion.initial_sign * vec2(-motion.input_velocity.y, motion.input_velocity.x);
-
-			perpendicular_acceleration = normalize(perpendicular_acceleration);
-			perpendicular_acceleration *= acceleration_magnitude;
-			motion.acceleration = perpendicular_acceleration;
-			motion.input_velocity += motion.acceleration * step_seconds;
+		if (!registry.objects.has(attractor))
+			continue;
+		const Attractor& attractor_attract = registry.attractors.read(attractor);
+		Object& attractor_object = registry.objects.at(attractor);
+		attractor_object.angle += 0.0001f*elapsed_ms;
+		if (attractor_object.angle >= 360.f) {
+			attractor_object.angle -= 360.f;
 		}
+		registry.objects.mark_changed(attractor);
+		attractor_field.add(attractor_object.position, attractor_attract.radius, attractor_attract.force);
+	}
+	attractor_field.build();
 
-		////	
-		////	
-		////	
+	// calculate external velocity (from attractors) for everything that isn't an attractor itself
+	registry.view<Motion, Object>(exclude<Attractor>).each([&](Entity, Motion& motion, Object& object)
+	{
+		motion.external_velocity = attractor_field.velocity_at(object.position);
+	});
+
+	// bend the trajectory of everything that isn't controlled by the player or an attractor
+	registry.view<Motion>(exclude<Player, Attractor>).each([&](Entity, Motion& motion)
+	{
+		float acceleration_magnitude = length(motion.acceleration);
 
+		// Adjust the perpendicular acceleration vector based on the sign of the starting acceleration
+		vec2 perpendicular_acceleration = motion.initial_sign * vec2(-motion.input_velocity.y, motion.input_velocity.x);
 
-		// update position based on velocity
-		vec3 trans_input = transform.mat * vec3(motion.input_velocity, 1.0f); // updating according to rotation
-		vec2 result = vec2(trans_input.x, trans_input.y) + motion.external_velocity;
-		object.position += result * step_seconds;
-		
-	}
+		perpendicular_acceleration = normalize(perpendicular_acceleration);
+		perpendicular_acceleration *= acceleration_magnitude;
+		motion.acceleration = perpendicular_acceleration;
+		motion.input_velocity += motion.acceleration * step_seconds;
+	});
+
+	// update position based on velocity
+	// The group keeps Motion and Object in the same order, so this walks both arrays in lockstep
+	// Only entities that actually moved are marked as changed, see WorldSystem::update_bounding_boxes
+	registry.motionObjects.each([&](Entity entity, Motion& motion, Object& object)
+	{
+		// rotate the input velocity (input from controls or set input for entities) by the object's angle,
+		// this is the rotation part of Transform::rotate written out
+		float c = cosf(object.angle);
+		float s = sinf(object.angle);
+		vec2 input = { c * motion.input_velocity.x - s * motion.input_velocity.y,
+		               s * motion.input_velocity.x + c * motion.input_velocity.y };
+		vec2 result = input + motion.external_velocity;
+		if (result.x != 0.f || result.y != 0.f)
+		{
+			object.position += result * step_seconds;
+			registry.objects.mark_changed(entity);
+		}
+	});
 
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 	// CHECK FOR COLLISIONS
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
 	// Check for collisions between all moving entities
-    ComponentContainer<Object> & object_container = registry.objects;
-	for(uint i = 0; i< object_container.components.size(); i++)
+	// Only objects with a Collider on a layer that collides with something take part, they are gathered
+	// in the order of the object container. The broadphase only hands out pairs that may overlap, in the
+	// same (i, j), i < j order as a double loop over them would, so the collisions are recorded in the
+	// same order as well. Pairs of layers that the filter doesn't enable skip the circle test, which
+	// runs over all remaining pairs at once (see find_hits) on the centres and radii gathered here.
+	const CollisionFilter& filter = registry.ctx<CollisionFilter>();
+	ComponentContainer<Object> & object_container = registry.objects;
+	collider_objects.clear();
+	collider_entities.clear();
+	collider_layers.clear();
+	collider_circles.clear();
+	for (size_t i = 0; i < object_container.components.size(); i++)
 	{
-		Object& object_i = object_container.components[i];
-		
-		// note starting j at i+1 to compare all (i,j) pairs only once (and to not compare with itself)
-		for(uint j = i+1; j< object_container.components.size(); j++)
-		{
-			Object& object_j = object_container.components[j];
-			if (collides(object_i, object_j))
-			{
-				Entity entity_i = object_container.entities[i];
-				Entity entity_j = object_container.entities[j];
-				// Create a collisions event
-				// We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity
-				registry.collisions.emplace_with_duplicates(entity_i, entity_j);
-				registry.collisions.emplace_with_duplicates(entity_j, entity_i);
-			}
-		}
+		Entity entity = object_container.entities[i];
+		if (!registry.colliders.has(entity))
+			continue;
+		COLLISION_LAYER layer = registry.colliders.read(entity).layer;
+		if (filter.mask_of(layer) == 0)
+			continue;
+		collider_objects.push_back(object_container.components[i]);
+		collider_entities.push_back(entity);
+		collider_layers.push_back(layer);
+		collider_circles.push_back(object_container.components[i].position, collision_radius_squared(object_container.components[i]));
+	}
+
+	if (broadphase == Broadphase::AABB_TREE)
+		tree.find_pairs(collider_objects.data(), collider_entities.data(), collider_objects.size(), candidate_pairs);
+	else
+		grid.find_pairs(collider_objects.data(), collider_objects.size(), candidate_pairs);
+	candidate_pairs.erase(std::remove_if(candidate_pairs.begin(), candidate_pairs.end(), [&](const ObjectPair& pair) {
+		return !filter.collides(collider_layers[pair.first], collider_layers[pair.second]);
+	}), candidate_pairs.end());
+
+	hit_pairs.clear();
+	find_hits(collider_circles, candidate_pairs.data(), candidate_pairs.size(), hit_pairs, narrowphase);
+	for (const ObjectPair& pair : hit_pairs)
+	{
+		Entity entity_i = collider_entities[pair.first];
+		Entity entity_j = collider_entities[pair.second];
+		COLLISION_LAYER layer_i = collider_layers[pair.first];
+		COLLISION_LAYER layer_j = collider_layers[pair.second];
+		// Create a collisions event
+		// We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity
+		registry.collisions.emplace_with_duplicates(entity_i, entity_j, layer_i, layer_j);
+		registry.collisions.emplace_with_duplicates(entity_j, entity_i, layer_j, layer_i);
 	}
 
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
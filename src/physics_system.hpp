@@ -4,6 +4,16 @@
 #include "tiny_ecs.hpp"
 #include "components.hpp"
 #include "tiny_ecs_registry.hpp"
+#include "spatial_hash_grid.hpp"
+#include "dynamic_aabb_tree.hpp"
+#include "narrowphase.hpp"
+#include "attractor_field.hpp"
+
+// The circle test used for all collisions, see physics_system.cpp
+bool collides(const Object& object1, const Object& object2);
+
+// The squared radius of the circle that collides() puts around an object
+float collision_radius_squared(const Object& object);
 
 // A simple physics system that moves rigid bodies and checks for collision
 class PhysicsSystem
@@ -11,7 +21,49 @@ class PhysicsSystem
 public:
 	void step(float elapsed_ms);
 
-	PhysicsSystem()
-	{
-	}
+	// Connects the attractor index to the lifecycle signals of registry.attractors
+	PhysicsSystem();
+	~PhysicsSystem();
+
+	PhysicsSystem(const PhysicsSystem&) = delete;
+	PhysicsSystem& operator=(const PhysicsSystem&) = delete;
+
+	// Broadphase of the collision check, both find the same collisions. The tree copes better with
+	// objects of very different sizes, the grid with many objects of about the same size.
+	enum class Broadphase { SPATIAL_HASH, AABB_TREE };
+	Broadphase broadphase = Broadphase::SPATIAL_HASH;
+
+	// Implementation of the circle test, by default the one that measured fastest on this CPU
+	NarrowphaseKernel narrowphase = best_narrowphase_kernel();
+
+	// The persistent tree of the AABB_TREE broadphase, e.g., for region and ray queries
+	const DynamicAabbTree& get_tree() const { return tree.get_tree(); }
+
+private:
+	// The pull of all attractors, rebuilt every step
+	AttractorField attractor_field;
+
+	// The entities with an Attractor, kept up to date by the on_construct and on_destroy signals of
+	// registry.attractors instead of scanning for them every step
+	std::vector<Entity> attractor_entities;
+	std::vector<unsigned int> attractor_positions; // position in 'attractor_entities' by Entity::index()
+	unsigned int attractor_construct_listener;
+	unsigned int attractor_destroy_listener;
+
+	void add_attractor(Entity e);
+	void remove_attractor(Entity e);
+
+	// Compare the index with a full scan of the attractors, for asserts
+	bool attractor_index_matches_scan();
+
+	SpatialHashGrid grid;
+	AabbTreeBroadphase tree;
+	std::vector<ObjectPair> candidate_pairs; // the broadphase output, re-used across steps
+
+	// The objects that take part in the collision check, with their owners and layers, gathered every step
+	std::vector<Object> collider_objects;
+	std::vector<Entity> collider_entities;
+	std::vector<COLLISION_LAYER> collider_layers;
+	CircleColliders collider_circles;
+	std::vector<ObjectPair> hit_pairs; // the narrowphase output
 };
\ No newline at end of file
@@ -0,0 +1,206 @@
+// Header
+#include "prefab.hpp"
+#include "tiny_ecs_registry.hpp"
+#include "world_init.hpp"
+
+// stlib
+#include <fstream>
+#include <sstream>
+
+// Names of the asset enumerators as written in the prefab file, in enumerator order
+static const char* texture_names[texture_count] = { "FISH", "EEL", "WHIRLPOOL", "PUFFER" };
+static const char* effect_names[effect_count] = { "COLOURED", "EGG", "SALMON", "TEXTURED", "WATER" };
+static const char* geometry_names[geometry_count] = { "SALMON", "SPRITE", "EGG", "DEBUG_LINE", "SCREEN_TRIANGLE" };
+static const char* layer_names[collision_layer_count] = { "PLAYER", "PREY", "HAZARD", "ATTRACTOR", "DECORATION" };
+
+// Read an enumerator by name, 'count' (the XXX_COUNT value) if the name is unknown
+template <typename Enum>
+static bool read_asset(std::istringstream& line, const char* const* names, int count, Enum& value)
+{
+	std::string name;
+	line >> name;
+	for (int i = 0; i < count; i++)
+	{
+		if (name == names[i])
+		{
+			value = (Enum)i;
+			return true;
+		}
+	}
+	value = (Enum)count;
+	return false;
+}
+
+bool PrefabLibrary::load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		fprintf(stderr, "Failed to open prefab file %s\n", path.c_str());
+		return false;
+	}
+
+	prefabs.clear();
+	std::string text;
+	int line_number = 0;
+	while (std::getline(file, text))
+	{
+		line_number++;
+		std::istringstream line(text);
+		std::string key;
+		if (!(line >> key) || key[0] == '#')
+			continue;
+
+		if (key == "prefab")
+		{
+			prefabs.push_back(Prefab());
+			line >> prefabs.back().name;
+			continue;
+		}
+		if (prefabs.empty())
+		{
+			fprintf(stderr, "%s:%d: component '%s' outside of a prefab\n", path.c_str(), line_number, key.c_str());
+			return false;
+		}
+
+		Prefab& prefab = prefabs.back();
+		bool valid = true;
+		if (key == "mesh")
+		{
+			valid = read_asset(line, geometry_names, geometry_count, prefab.mesh);
+			prefab.components |= registry.mask<Mesh*>();
+		}
+		else if (key == "motion")
+		{
+			line >> prefab.motion.input_velocity.x >> prefab.motion.input_velocity.y
+				>> prefab.motion.acceleration.x >> prefab.motion.acceleration.y;
+			prefab.components |= registry.mask<Motion>();
+		}
+		else if (key == "object")
+		{
+			line >> prefab.object.angle >> prefab.object.scale.x >> prefab.object.scale.y;
+			prefab.components |= registry.mask<Object>();
+		}
+		else if (key == "bounding_box")
+			prefab.components |= registry.mask<BoundingBox>();
+		else if (key == "tracker_lines")
+			prefab.tracker_lines = true;
+		else if (key == "eatable")
+		{
+			line >> prefab.eatable.points;
+			prefab.components |= registry.mask<Eatable>();
+		}
+		else if (key == "deadly")
+			prefab.components |= registry.mask<Deadly>();
+		else if (key == "attractor")
+		{
+			line >> prefab.attractor.radius >> prefab.attractor.force;
+			prefab.components |= registry.mask<Attractor>();
+		}
+		else if (key == "collider")
+		{
+			valid = read_asset(line, layer_names, collision_layer_count, prefab.collider.layer);
+			prefab.components |= registry.mask<Collider>();
+		}
+		else if (key == "death_timer")
+		{
+			line >> prefab.death_timer.counter_ms;
+			prefab.components |= registry.mask<DeathTimer>();
+		}
+		else if (key == "render")
+		{
+			valid = read_asset(line, texture_names, texture_count, prefab.render_request.used_texture)
+				& read_asset(line, effect_names, effect_count, prefab.render_request.used_effect)
+				& read_asset(line, geometry_names, geometry_count, prefab.render_request.used_geometry);
+			prefab.components |= registry.mask<RenderRequest>();
+		}
+		else
+			valid = false;
+
+		if (!valid || line.fail())
+		{
+			fprintf(stderr, "%s:%d: invalid line '%s'\n", path.c_str(), line_number, text.c_str());
+			return false;
+		}
+	}
+
+	// the bounding box is computed from the Object, and the tracker lines from the bounding box
+	for (const Prefab& prefab : prefabs)
+	{
+		bool has_box = (prefab.components & registry.mask<BoundingBox>()) != 0;
+		if ((has_box && !(prefab.components & registry.mask<Object>())) || (prefab.tracker_lines && !has_box))
+		{
+			fprintf(stderr, "%s: prefab %s needs an object for its bounding box and a bounding box for its tracker lines\n", path.c_str(), prefab.name.c_str());
+			return false;
+		}
+	}
+	printf("Loaded %zu prefabs from %s\n", prefabs.size(), path.c_str());
+	return true;
+}
+
+const Prefab* PrefabLibrary::find(const std::string& name) const
+{
+	for (const Prefab& prefab : prefabs)
+		if (prefab.name == name)
+			return &prefab;
+	return nullptr;
+}
+
+Entity instantiate(RenderSystem* renderer, const Prefab& prefab, const PrefabOverrides& overrides)
+{
+	Entity entity = Entity();
+	assign_prefab(renderer, entity, prefab, overrides);
+	if (prefab.tracker_lines)
+		createTrackerLines(entity);
+	return entity;
+}
+
+void assign_prefab(RenderSystem* renderer, Entity entity, const Prefab& prefab, const PrefabOverrides& overrides)
+{
+	Signature components = prefab.components;
+
+	if (components & registry.mask<Mesh*>())
+		registry.meshPtrs.insert(entity, &renderer->getMesh(prefab.mesh));
+
+	// Note, the Motion is inserted before the Object, see createSalmon
+	if (components & registry.mask<Motion>())
+	{
+		Motion motion = prefab.motion;
+		motion.acceleration *= overrides.acceleration_scale;
+		motion.initial_sign = copysignf(motion.initial_sign, overrides.acceleration_scale.x);
+		registry.motions.insert(entity, motion);
+	}
+
+	Object object = prefab.object;
+	object.position = overrides.position;
+	object.scale *= overrides.size;
+	if (components & registry.mask<Object>())
+		registry.objects.insert(entity, object);
+
+	if (components & registry.mask<BoundingBox>())
+	{
+		BoundingBox bb;
+		vec4 bb_info = calculate_AABB(object);
+		bb.bounding_box = vec2(bb_info.x, bb_info.y);
+		bb.pos = vec2(bb_info.z, bb_info.w);
+		registry.boundingBoxes.insert(entity, bb);
+	}
+
+	if (components & registry.mask<Eatable>())
+		registry.eatables.insert(entity, prefab.eatable);
+	if (components & registry.mask<Deadly>())
+		registry.deadlys.insert(entity, Deadly());
+	if (components & registry.mask<Attractor>())
+	{
+		Attractor attractor = prefab.attractor;
+		attractor.force *= overrides.size;
+		attractor.radius *= overrides.size;
+		registry.attractors.insert(entity, attractor);
+	}
+	if (components & registry.mask<Collider>())
+		registry.colliders.insert(entity, prefab.collider);
+	if (components & registry.mask<DeathTimer>())
+		registry.deathTimers.insert(entity, prefab.death_timer);
+	if (components & registry.mask<RenderRequest>())
+		registry.renderRequests.insert(entity, prefab.render_request);
+}
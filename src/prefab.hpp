@@ -0,0 +1,57 @@
+#pragma once
+
+// stlib
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "tiny_ecs.hpp"
+#include "components.hpp"
+#include "render_system.hpp"
+
+// An immutable entity template: the components an entity starts with and their default values.
+// Prefabs are loaded from data/prefabs.txt, so new kinds of entities need no new code.
+struct Prefab
+{
+	std::string name;
+	Signature components = 0; // the components of the template, see ECSRegistry::mask
+	bool tracker_lines = false;
+
+	// default values, only those in 'components' are used
+	GEOMETRY_BUFFER_ID mesh = GEOMETRY_BUFFER_ID::GEOMETRY_COUNT;
+	Motion motion;
+	Object object;
+	Eatable eatable;
+	Attractor attractor;
+	Collider collider;
+	DeathTimer death_timer;
+	RenderRequest render_request;
+};
+
+// Per-instance changes to the defaults of a prefab
+struct PrefabOverrides
+{
+	vec2 position = { 0.f, 0.f };
+	// multiplies the Object scale, and the radius and force of an Attractor
+	float size = 1.f;
+	// multiplies the Motion acceleration, a negative x also flips Motion::initial_sign
+	vec2 acceleration_scale = { 1.f, 1.f };
+};
+
+class PrefabLibrary
+{
+	std::vector<Prefab> prefabs;
+
+public:
+	// Read all prefabs of a file, see data/prefabs.txt for the format
+	bool load(const std::string& path);
+
+	// The prefab called 'name', nullptr if there is none
+	const Prefab* find(const std::string& name) const;
+};
+
+// Create an entity from a prefab by copying its default components into the registry
+Entity instantiate(RenderSystem* renderer, const Prefab& prefab, const PrefabOverrides& overrides);
+
+// Add the components of a prefab to an existing entity that has none of them, the tracker lines are left out
+void assign_prefab(RenderSystem* renderer, Entity entity, const Prefab& prefab, const PrefabOverrides& overrides);
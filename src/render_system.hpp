@@ -78,7 +78,7 @@ public:
 
 private:
 	// Internal drawing functions for each entity type
-	void drawTexturedMesh(Entity entity, const mat3& projection);
+	void drawTexturedMesh(Entity entity, const Object& object, const RenderRequest& render_request, const mat3& projection);
 	void drawToScreen();
 
 	// Window handle
@@ -88,8 +88,6 @@ private:
 	GLuint frame_buffer;
 	GLuint off_screen_render_buffer_color;
 	GLuint off_screen_render_buffer_depth;
-
-	Entity screen_state_entity;
 };
 
 bool loadEffectFromFile(
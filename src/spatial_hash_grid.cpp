@@ -0,0 +1,105 @@
+// Header
+#include "spatial_hash_grid.hpp"
+
+// stlib
+#include <algorithm>
+
+const unsigned int SpatialHashGrid::max_cells_per_object;
+
+SpatialHashGrid::SpatialHashGrid(float cell_size)
+	: cell_size(cell_size)
+{
+}
+
+// Cell of a world coordinate, clamped so that objects far outside the window can't overflow an int
+static int cell_of(float x, float inverse_cell_size)
+{
+	float cell = floorf(x * inverse_cell_size);
+	return (int)std::min(1e9f, std::max(-1e9f, cell));
+}
+
+static unsigned int hash_cell(int x, int y)
+{
+	return ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u);
+}
+
+static uint64_t pair_key(unsigned int a, unsigned int b)
+{
+	return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+void SpatialHashGrid::find_pairs(const Object* objects, size_t count, std::vector<ObjectPair>& pairs)
+{
+	pairs.clear();
+	keys.clear();
+	bucket_of_entry.clear();
+	object_of_entry.clear();
+	oversized.clear();
+
+	// enter every object into the cells its bounding circle overlaps
+	float inverse_cell_size = 1.f / cell_size;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const Object& object = objects[i];
+		float radius = broadphase_radius(object);
+		int x0 = cell_of(object.position.x - radius, inverse_cell_size);
+		int x1 = cell_of(object.position.x + radius, inverse_cell_size);
+		int y0 = cell_of(object.position.y - radius, inverse_cell_size);
+		int y1 = cell_of(object.position.y + radius, inverse_cell_size);
+		if ((int64_t)(x1 - x0 + 1) * (int64_t)(y1 - y0 + 1) > max_cells_per_object)
+		{
+			oversized.push_back(i);
+			continue;
+		}
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int x = x0; x <= x1; x++)
+			{
+				bucket_of_entry.push_back(hash_cell(x, y));
+				object_of_entry.push_back(i);
+			}
+		}
+	}
+
+	// group the entries by bucket, the table has at least twice as many buckets as entries
+	size_t entry_count = bucket_of_entry.size();
+	unsigned int bucket_count = 1;
+	while (bucket_count < 2 * entry_count)
+		bucket_count <<= 1;
+	unsigned int mask = bucket_count - 1;
+	bucket_start.assign(bucket_count + 1, 0);
+	for (size_t e = 0; e < entry_count; e++)
+		bucket_start[(bucket_of_entry[e] & mask) + 1]++;
+	for (unsigned int b = 0; b < bucket_count; b++)
+		bucket_start[b + 1] += bucket_start[b];
+	sorted_objects.resize(entry_count);
+	for (size_t e = 0; e < entry_count; e++)
+		sorted_objects[bucket_start[bucket_of_entry[e] & mask]++] = object_of_entry[e];
+	// the fill advanced every start to the end of its bucket, which is the start of the next one
+
+	// every two objects in a bucket are candidates, different cells may share a bucket
+	unsigned int begin = 0;
+	for (unsigned int b = 0; b < bucket_count; b++)
+	{
+		unsigned int end = bucket_start[b];
+		for (unsigned int i = begin; i < end; i++)
+			for (unsigned int j = i + 1; j < end; j++)
+				if (sorted_objects[i] != sorted_objects[j])
+					keys.push_back(pair_key(sorted_objects[i], sorted_objects[j]));
+		begin = end;
+	}
+	for (unsigned int big : oversized)
+		for (unsigned int other = 0; other < count; other++)
+			if (other != big)
+				keys.push_back(pair_key(big, other));
+
+	// objects sharing several cells are found several times
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	pairs.resize(keys.size());
+	for (size_t k = 0; k < keys.size(); k++)
+	{
+		pairs[k].first = (unsigned int)(keys[k] >> 32);
+		pairs[k].second = (unsigned int)keys[k];
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// stlib
+#include <cstdint>
+#include <vector>
+
+#include "common.hpp"
+#include "components.hpp"
+
+// Two positions in an array of objects, first < second
+struct ObjectPair
+{
+	unsigned int first;
+	unsigned int second;
+};
+
+// Radius of the bounding circle of collides(), a bit larger so rounding can't drop a pair
+inline float broadphase_radius(const Object& object)
+{
+	vec2 half_size = abs(object.scale) / 2.f;
+	return length(half_size) * 1.001f + 0.01f;
+}
+
+// Broadphase for the circle test of PhysicsSystem (see collides). Every object is entered into all
+// cells of a uniform grid that the square around its bounding circle overlaps, and only objects that
+// share a cell become candidate pairs. The grid is a spatial hash: cells are buckets of a table, so the
+// world is unbounded and the memory only depends on the number of objects. It is rebuilt every step.
+class SpatialHashGrid
+{
+public:
+	// Objects that would cover more cells than this are tested against every other object instead
+	static const unsigned int max_cells_per_object = 64;
+
+	explicit SpatialHashGrid(float cell_size = 128.f);
+
+	// All pairs of objects whose bounding circles may overlap, sorted by (first, second) and without
+	// duplicates, i.e., in the order of the brute force double loop over the objects
+	void find_pairs(const Object* objects, size_t count, std::vector<ObjectPair>& pairs);
+
+	float get_cell_size() const { return cell_size; }
+
+private:
+	float cell_size;
+
+	// (bucket, object) entries, grouped by bucket with a counting sort
+	std::vector<unsigned int> bucket_of_entry;
+	std::vector<unsigned int> object_of_entry;
+	std::vector<unsigned int> bucket_start;
+	std::vector<unsigned int> sorted_objects;
+	std::vector<unsigned int> oversized;
+	std::vector<uint64_t> keys;
+};
@@ -1,5 +1,9 @@
 // internal
 #include "tiny_ecs.hpp"
 
-// All we need to store besides the containers is the id of every entity and callbacks to be able to remove entities across containers
-unsigned int Entity::id_count = 1;
\ No newline at end of file
+// All we need to store besides the containers is the generation of every entity slot and the slots free for re-use
+std::vector<unsigned int> Entity::generations(1, 0);
+std::vector<unsigned int> Entity::free_indices;
+const unsigned int Entity::index_bits;
+const unsigned int Entity::index_mask;
+const unsigned int Entity::generation_mask;
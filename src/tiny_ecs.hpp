@@ -2,65 +2,597 @@
 
 #include <algorithm>
 #include <vector>
-#include <unordered_map>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <set>
 #include <functional>
 #include <typeindex>
+#include <cstring>
+#include <new>
 #include <assert.h>
 
+// A sequence of T stored in fixed-size pages that are never moved or freed once allocated, so
+// inserting (push_back) never invalidates references or pointers to existing elements, unlike
+// std::vector. pop_back and clear only destroy elements. Implements the part of the std::vector
+// interface used by ComponentContainer, see component_storage.
+template <typename T, unsigned int PageSize = 1024>
+class PagedVector
+{
+	static_assert((PageSize & (PageSize - 1)) == 0, "The page size must be a power of two");
+
+	struct Page
+	{
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type slots[PageSize];
+	};
+	std::vector<std::unique_ptr<Page>> pages;
+	size_t count = 0;
+
+	T* slot(size_t i) const
+	{
+		return reinterpret_cast<T*>(&pages[i / PageSize]->slots[i % PageSize]);
+	}
+
+public:
+	static const unsigned int page_size = PageSize;
+
+	PagedVector() = default;
+	PagedVector(const PagedVector&) = delete;
+	PagedVector& operator=(const PagedVector&) = delete;
+
+	~PagedVector()
+	{
+		clear();
+	}
+
+	T& operator[](size_t i) { return *slot(i); }
+	const T& operator[](size_t i) const { return *slot(i); }
+	T& back() { return *slot(count - 1); }
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	size_t capacity() const { return pages.size() * PageSize; }
+
+	// Allocate pages for at least n elements
+	void reserve(size_t n)
+	{
+		while (capacity() < n)
+			pages.emplace_back(new Page);
+	}
+
+	void push_back(T&& value)
+	{
+		reserve(count + 1);
+		new (slot(count)) T(std::move(value));
+		count++;
+	}
+
+	void push_back(const T& value)
+	{
+		reserve(count + 1);
+		new (slot(count)) T(value);
+		count++;
+	}
+
+	void pop_back()
+	{
+		count--;
+		slot(count)->~T();
+	}
+
+	// Destroy all elements, the pages are kept for re-use
+	void clear()
+	{
+		while (count > 0)
+			pop_back();
+	}
+
+	void assign(const T* first, const T* last)
+	{
+		clear();
+		reserve(last - first);
+		for (; first != last; ++first)
+			push_back(*first);
+	}
+
+	// The elements of page p are contiguous, page_elements(p) of them
+	const T* page_data(size_t p) const { return slot(p * PageSize); }
+	size_t page_elements(size_t p) const { return std::min<size_t>(PageSize, count - p * PageSize); }
+	size_t used_pages() const { return (count + PageSize - 1) / PageSize; }
+};
+
+template <typename T, unsigned int PageSize>
+const unsigned int PagedVector<T, PageSize>::page_size;
+
+// Storage policy of the dense component array of ComponentContainer<Component>: std::vector by default,
+// which keeps iteration fastest. Specialize it to PagedVector for components whose references have to
+// stay valid while other components of the same type are inserted, e.g.,
+//   template <> struct component_storage<Relationship> { typedef PagedVector<Relationship> type; };
+// Note, removing a component still moves the last one into its place.
+template <typename Component>
+struct component_storage
+{
+	typedef std::vector<Component> type;
+};
+
+// Appends plain data to a binary blob, see ECSRegistry::save_snapshot
+// Arrays are padded to start at a multiple of 'alignment', so they can be read in place and copied in bulk.
+class SnapshotWriter
+{
+	std::vector<char>& out;
+
+	void write_bytes(const void* data, size_t bytes)
+	{
+		size_t at = out.size();
+		out.resize(at + bytes);
+		if (bytes > 0)
+			std::memcpy(out.data() + at, data, bytes);
+	}
+
+public:
+	static const size_t alignment = 16;
+
+	SnapshotWriter(std::vector<char>& out) : out(out)
+	{
+		out.clear();
+	}
+
+	template <typename T>
+	void write(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be written to a snapshot");
+		write_bytes(&value, sizeof(T));
+	}
+
+	// Writes the element count followed by the raw elements
+	template <typename T>
+	void write_array(const T* data, size_t count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be written to a snapshot");
+		write((unsigned long long)count);
+		out.resize((out.size() + alignment - 1) / alignment * alignment, 0);
+		write_bytes(data, count * sizeof(T));
+	}
+	template <typename T>
+	void write_array(const std::vector<T>& values)
+	{
+		write_array(values.data(), values.size());
+	}
+
+	// Same layout as a contiguous array, written page by page
+	template <typename T, unsigned int PageSize>
+	void write_array(const PagedVector<T, PageSize>& values)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be written to a snapshot");
+		write((unsigned long long)values.size());
+		out.resize((out.size() + alignment - 1) / alignment * alignment, 0);
+		for (size_t p = 0; p < values.used_pages(); p++)
+			write_bytes(values.page_data(p), values.page_elements(p) * sizeof(T));
+	}
+};
+
+// Reads back what a SnapshotWriter wrote. Reading past the end of the blob fails the reader
+// instead of reading garbage, check ok() afterwards.
+class SnapshotReader
+{
+	const std::vector<char>& in;
+	size_t cursor = 0;
+	bool failed = false;
+
+	const char* take(size_t bytes)
+	{
+		if (failed || in.size() - cursor < bytes)
+		{
+			failed = true;
+			return nullptr;
+		}
+		const char* data = in.data() + cursor;
+		cursor += bytes;
+		return data;
+	}
+
+public:
+	SnapshotReader(const std::vector<char>& in) : in(in)
+	{
+	}
+
+	template <typename T>
+	bool read(T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be read from a snapshot");
+		const char* data = take(sizeof(T));
+		if (data != nullptr)
+			std::memcpy(&value, data, sizeof(T));
+		return data != nullptr;
+	}
+
+	// Returns the array in place (valid as long as the blob is), or nullptr if the blob is too short
+	template <typename T>
+	const T* read_array(size_t& count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be read from a snapshot");
+		unsigned long long stored = 0;
+		count = 0;
+		if (!read(stored))
+			return nullptr;
+		size_t padded = (cursor + SnapshotWriter::alignment - 1) / SnapshotWriter::alignment * SnapshotWriter::alignment;
+		if (padded > in.size() || stored > (in.size() - padded) / sizeof(T))
+		{
+			failed = true;
+			return nullptr;
+		}
+		cursor = padded;
+		const T* data = reinterpret_cast<const T*>(take((size_t)stored * sizeof(T)));
+		assert(((size_t)data % alignof(T)) == 0);
+		count = (size_t)stored;
+		return data;
+	}
+
+	// Move past 'bytes' bytes, e.g., a header that was already checked
+	bool skip(size_t bytes)
+	{
+		return take(bytes) != nullptr;
+	}
+
+	bool ok() const { return !failed; }
+	bool at_end() const { return cursor == in.size(); }
+};
+
 // Unique identifyer for all entities
+// The id packs a slot index (low bits) and the generation of that slot (high bits).
+// Slots of destroyed entities are re-used from a free list, so indices stay dense, and the
+// generation is bumped on every destroy so that stale copies of the handle can be detected.
 class Entity
 {
 	unsigned int id;
-	static unsigned int id_count; // starts from 1, entit 0 is the default initialization
+
+	static std::vector<unsigned int> generations; // current generation of every slot, slot 0 is the default initialization
+	static std::vector<unsigned int> free_indices; // slots of destroyed entities, re-used last-in first-out
+
+	// Wraps an existing id without allocating a new one
+	struct existing_id {};
+	Entity(existing_id, unsigned int id) : id(id) {}
 public:
+	static const unsigned int index_bits = 20; // up to ~1M entities alive at the same time
+	static const unsigned int index_mask = (1u << index_bits) - 1;
+	static const unsigned int generation_mask = (1u << (32 - index_bits)) - 1;
+
 	Entity()
 	{
-		id = id_count++;
-		// Note, indices of already deleted entities arent re-used in this simple implementation.
+		unsigned int index;
+		if (!free_indices.empty())
+		{
+			index = free_indices.back();
+			free_indices.pop_back();
+		}
+		else
+		{
+			index = (unsigned int)generations.size();
+			assert(index <= index_mask && "Too many entities alive at the same time");
+			generations.push_back(0);
+		}
+		id = (generations[index] << index_bits) | index;
+	}
+	operator unsigned int() const { return id; } // this enables automatic casting to int
+
+	// The slot of the entity, used to index per-entity arrays
+	unsigned int index() const { return id & index_mask; }
+	unsigned int generation() const { return id >> index_bits; }
+
+	// Check if the handle still refers to a living entity (and not to a destroyed or re-used slot)
+	static bool is_alive(Entity e)
+	{
+		return e.index() != 0 && e.index() < generations.size() && generations[e.index()] == e.generation();
+	}
+
+	// Release the slot of e for re-use, invalidating all copies of the handle.
+	// Note, this does not remove components, see ECSRegistry::remove_all_components_of
+	static void destroy(Entity e)
+	{
+		if (!is_alive(e))
+			return;
+		generations[e.index()] = (generations[e.index()] + 1) & generation_mask;
+		free_indices.push_back(e.index());
+	}
+
+	// The null handle, it refers to the reserved slot 0 and is never alive
+	static Entity null()
+	{
+		return Entity(existing_id(), 0);
+	}
+
+	// The handle of the entity currently living in slot 'index'
+	static Entity from_index(unsigned int index)
+	{
+		assert(index < generations.size());
+		return Entity(existing_id(), (generations[index] << index_bits) | index);
+	}
+
+	// Number of slots ever handed out, i.e., the range of Entity::index()
+	static size_t capacity() { return generations.size(); }
+
+	// Number of slots waiting for re-use
+	static size_t free_count() { return free_indices.size(); }
+
+	// Write the generations and the free list, so a snapshot can restore exactly the same handles
+	static void save_slots(SnapshotWriter& writer)
+	{
+		writer.write_array(generations.data(), generations.size());
+		writer.write_array(free_indices.data(), free_indices.size());
+	}
+
+	// Replace the generations and the free list with those of a snapshot.
+	// Handles taken after the snapshot must stay stale, so every slot that is free in the snapshot gets
+	// the next generation after both the stored and the current one, even if the two are equal: the slot
+	// may have been re-used with the same generation after the snapshot. Slots that only exist now are
+	// kept as free slots after the restored free list. Entities alive in the snapshot keep their stored
+	// generation, since the restored components refer to them by it.
+	static bool load_slots(SnapshotReader& reader)
+	{
+		size_t generation_count, free_count;
+		const unsigned int* stored_generations = reader.read_array<unsigned int>(generation_count);
+		const unsigned int* stored_free = reader.read_array<unsigned int>(free_count);
+		if (!reader.ok() || generation_count == 0)
+			return false;
+		// every free slot must be a valid index and listed once, or create() would hand it out twice
+		std::vector<bool> listed(generation_count, false);
+		for (size_t i = 0; i < free_count; i++)
+		{
+			if (stored_free[i] == 0 || stored_free[i] >= generation_count || listed[stored_free[i]])
+				return false;
+			listed[stored_free[i]] = true;
+		}
+
+		std::vector<unsigned int> restored(stored_generations, stored_generations + generation_count);
+		for (size_t i = 0; i < free_count; i++)
+		{
+			unsigned int index = stored_free[i];
+			if (index < generations.size())
+				restored[index] = (std::max(generations[index], restored[index]) + 1) & generation_mask;
+		}
+		std::vector<unsigned int> restored_free;
+		for (size_t index = generation_count; index < generations.size(); index++)
+		{
+			restored.push_back((generations[index] + 1) & generation_mask);
+			restored_free.push_back((unsigned int)index);
+		}
+		restored_free.insert(restored_free.end(), stored_free, stored_free + free_count);
+		generations.swap(restored);
+		free_indices.swap(restored_free);
+		return true;
+	}
+};
+
+// Position of type T in the type list 'List...', a compile error if T is not part of it
+template <typename T, typename... List>
+struct type_index_in;
+template <typename T, typename... Rest>
+struct type_index_in<T, T, Rest...>
+{
+	static const unsigned int value = 0;
+};
+template <typename T, typename First, typename... Rest>
+struct type_index_in<T, First, Rest...>
+{
+	static const unsigned int value = 1 + type_index_in<T, Rest...>::value;
+};
+
+// Bitmask of the component types an entity has, one bit per container of the registry
+typedef unsigned int Signature;
+
+// Index of the lowest set bit of a non-zero signature
+inline unsigned int lowest_bit(Signature signature)
+{
+	assert(signature != 0);
+	unsigned int bit = 0;
+	while ((signature & 1u) == 0)
+	{
+		signature >>= 1;
+		bit++;
+	}
+	return bit;
+}
+
+// Interface of an owning group that re-orders the containers it owns, see OwningGroup
+struct GroupInterface
+{
+	virtual void on_insert(Entity e) = 0; // called after e got a component in an owned container
+	virtual void on_remove(Entity e) = 0; // called before e loses a component in an owned container
+	// called before the components at 'positions' of an owned container are removed, the group may move
+	// them and updates 'positions' to where they are then
+	virtual void on_remove_batch(std::vector<unsigned int>& positions) = 0;
+	virtual void on_clear() = 0;
+};
+
+// A list of callbacks func(Entity) that a container calls on component lifecycle events, e.g.,
+// registry.attractors.on_construct.connect([](Entity e) { ... }). Secondary indices (spatial
+// structures, sort orders, ...) can use them to update incrementally instead of re-scanning a container.
+// Note, listeners must not add or remove components of the container that calls them.
+class Signal
+{
+	std::vector<std::pair<unsigned int, std::function<void(Entity)>>> listeners;
+	unsigned int next_id = 1;
+
+public:
+	// Returns an id for disconnect()
+	unsigned int connect(std::function<void(Entity)> listener)
+	{
+		listeners.emplace_back(next_id, std::move(listener));
+		return next_id++;
+	}
+
+	void disconnect(unsigned int id)
+	{
+		listeners.erase(std::remove_if(listeners.begin(), listeners.end(),
+			[id](const std::pair<unsigned int, std::function<void(Entity)>>& listener) { return listener.first == id; }),
+			listeners.end());
+	}
+
+	bool empty() const
+	{
+		return listeners.empty();
+	}
+
+	void emit(Entity e)
+	{
+		for (auto& listener : listeners)
+			listener.second(e);
 	}
-	operator unsigned int() { return id; } // this enables automatic casting to int
 };
 
-// Common interface to refer to all containers in the ECS registry
-struct ContainerInterface
+// Memory use of a container, see ComponentContainer::memory and ECSRegistry::memory_report
+struct ContainerMemory
 {
-	virtual void clear() = 0;
-	virtual size_t size() = 0;
-	virtual void remove(Entity e) = 0;
-	virtual bool has(Entity entity) = 0;
+	const char* type_name = ""; // typeid name of the component type
+	size_t size = 0; // number of components
+	size_t capacity = 0; // number of components that fit without reallocating
+	size_t high_water = 0; // largest size since the container was created
+	size_t used_bytes = 0; // the live components, entities and versions
+	size_t reserved_bytes = 0; // what the dense arrays have allocated, >= used_bytes
+	size_t index_bytes = 0; // the sparse pages (or the bitset of a tag container)
+	size_t index_pages = 0; // allocated sparse pages
+	float index_load = 0.f; // fraction of the allocated sparse slots that refer to a component
+	size_t scratch_bytes = 0; // buffers kept for remove_batch and sort
 };
 
 // A container that stores components of type 'Component' and associated entities
-template <typename Component> // A component can be any class
-class ComponentContainer : public ContainerInterface
+// Storage is a sparse set: a paged sparse array maps an entity to its position in the
+// densely packed 'components' and 'entities' arrays, so get() and has() are two array
+// lookups instead of a hash map probe, and iterating the dense arrays stays linear.
+template <typename Component, typename Enable = void> // A component can be any class
+class ComponentContainer
 {
+public:
+	typedef Component component_type;
+
 private:
-	// The hash map from Entity -> array index.
-	std::unordered_map<unsigned int, unsigned int> map_entity_componentID; // the entity is cast to uint to be hashable.
+	// Number of entities covered by one page of the sparse array (a power of two)
+	static const unsigned int sparse_page_size = 4096;
+	// Marks a sparse slot whose entity has no component in this container
+	static const unsigned int null_slot = ~0u;
+
+	// The paged sparse array from Entity::index() -> array index. Pages are only allocated once an
+	// entity in their range gets a component, and are kept (not freed) on remove and clear.
+	std::vector<std::unique_ptr<unsigned int[]>> sparse_pages;
 	bool registered = false;
+
+	// The owning group that decides the order of the first entries, if any
+	GroupInterface* owner = nullptr;
+
+	// Scratch space of remove_batch, kept to not allocate on every call
+	std::vector<unsigned int> batch_positions;
+	std::vector<unsigned char> batch_marks; // by dense position, all 0 between calls
+
+	// Drop the last element of the dense arrays
+	void pop_back()
+	{
+		components.pop_back();
+		entities.pop_back();
+		versions.pop_back();
+	}
+
+	// Change tracking: versions[i] is the container version at the last change of components[i]
+	std::vector<unsigned int> versions;
+	unsigned int current_version = 1;
+
+	// Largest number of components so far, see memory()
+	size_t high_water = 0;
+
+	// The per-entity signatures of the registry (if any) and the bit that stands for this container
+	std::vector<Signature>* signatures = nullptr;
+	Signature signature_bit = 0;
+
+	void set_signature_bit(Entity e)
+	{
+		if (signatures == nullptr)
+			return;
+		if (e.index() >= signatures->size())
+			signatures->resize(e.index() + 1, 0);
+		(*signatures)[e.index()] |= signature_bit;
+	}
+
+	void clear_signature_bit(Entity e)
+	{
+		if (signatures != nullptr)
+			(*signatures)[e.index()] &= ~signature_bit;
+	}
+	template <typename A, typename B> friend class OwningGroup;
+
+	// Returns the sparse slot of entity e, or nullptr if its page was never allocated
+	unsigned int* find_slot(Entity e)
+	{
+		unsigned int index = e.index();
+		unsigned int page = index / sparse_page_size;
+		if (page >= sparse_pages.size() || !sparse_pages[page])
+			return nullptr;
+		return &sparse_pages[page][index % sparse_page_size];
+	}
+
+	// Returns the sparse slot of entity e, allocating its page if necessary
+	unsigned int& assure_slot(Entity e)
+	{
+		unsigned int index = e.index();
+		unsigned int page = index / sparse_page_size;
+		if (page >= sparse_pages.size())
+			sparse_pages.resize(page + 1);
+		if (!sparse_pages[page])
+		{
+			sparse_pages[page].reset(new unsigned int[sparse_page_size]);
+			std::fill_n(sparse_pages[page].get(), sparse_page_size, null_slot);
+		}
+		return sparse_pages[page][index % sparse_page_size];
+	}
+
 public:
-	// Container of all components of type 'Component'
-	std::vector<Component> components;
+	// Container of all components of type 'Component', a std::vector unless component_storage says otherwise
+	typename component_storage<Component>::type components;
 
 	// The corresponding entities
 	std::vector<Entity> entities;
 
+	// Lifecycle signals: on_construct after a component was inserted, on_update on mutable access
+	// (get() and mark_changed()) and on_destroy before a component is removed
+	Signal on_construct;
+	Signal on_update;
+	Signal on_destroy;
+
 	// Constructor that registers the type
 	ComponentContainer()
 	{
 	}
 
+	// Called by the registry to have the container keep bit 'bit' of every entity signature up to date
+	void bind_signature(std::vector<Signature>* registry_signatures, Signature bit)
+	{
+		signatures = registry_signatures;
+		signature_bit = bit;
+	}
+
+	// The signature bit that stands for this container (0 if not part of a registry)
+	Signature signature_mask() const
+	{
+		return signature_bit;
+	}
+
 	// Inserting a component c associated to entity e
 	inline Component& insert(Entity e, Component c, bool check_for_duplicates = true)
 	{
 		// Usually, every entity should only have one instance of each component type
 		assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
 
-		map_entity_componentID[e] = (unsigned int)components.size();
+		// Note, for duplicates the sparse slot refers to the most recently inserted one
+		assure_slot(e) = (unsigned int)components.size();
 		components.push_back(std::move(c)); // the move enforces move instead of copy constructor
 		entities.push_back(e);
-		return components.back();
+		versions.push_back(current_version); // a new component counts as changed
+		high_water = std::max(high_water, components.size());
+		set_signature_bit(e);
+		// the group may move the new component to the front
+		if (owner != nullptr)
+			owner->on_insert(e);
+		on_construct.emit(e);
+		return components[*find_slot(e)];
 	};
 
 	// The emplace function takes the the provided arguments Args, creates a new object of type Component, and inserts it into the ECS system
@@ -73,15 +605,60 @@ public:
 		return insert(e, Component(std::forward<Args>(args)...), false);
 	};
 
+	// Insert a copy of 'prototype' for each of the 'count' entities, growing the arrays only once
+	void insert_n(const Entity* new_entities, size_t count, const Component& prototype)
+	{
+		reserve(components.size() + count);
+		for (size_t i = 0; i < count; i++)
+		{
+			Entity e = new_entities[i];
+			assert(!has(e) && "Entity already contained in ECS registry");
+			assure_slot(e) = (unsigned int)components.size();
+			components.push_back(prototype);
+			entities.push_back(e);
+			versions.push_back(current_version);
+			set_signature_bit(e);
+			if (owner != nullptr)
+				owner->on_insert(e);
+			on_construct.emit(e);
+		}
+		high_water = std::max(high_water, components.size());
+	}
+
+	// Make room for n components in total
+	void reserve(size_t n)
+	{
+		components.reserve(n);
+		entities.reserve(n);
+		versions.reserve(n);
+	}
+
 	// A wrapper to return the component of an entity
+	// Note, this is mutable access and marks the component as changed, see read() for lookups that don't write
 	Component& get(Entity e) {
 		assert(has(e) && "Entity not contained in ECS registry");
-		return components[map_entity_componentID[e]];
+		unsigned int cID = *find_slot(e);
+		versions[cID] = current_version;
+		on_update.emit(e);
+		return components[cID];
+	}
+
+	// The component of an entity for reading, doesn't mark it as changed
+	const Component& read(Entity e) {
+		assert(has(e) && "Entity not contained in ECS registry");
+		return components[*find_slot(e)];
+	}
+
+	// Mutable access without change tracking, used by views. Call mark_changed() after writing.
+	Component& at(Entity e) {
+		assert(has(e) && "Entity not contained in ECS registry");
+		return components[*find_slot(e)];
 	}
 
 	// Check if entity has a component of type 'Component'
 	bool has(Entity entity) {
-		return map_entity_componentID.count(entity) > 0;
+		const unsigned int* slot = find_slot(entity);
+		return slot != nullptr && *slot != null_slot && (unsigned int)entities[*slot] == (unsigned int)entity;
 	}
 
 	// Remove an component and pack the container to re-use the empty space
@@ -89,29 +666,131 @@ public:
 	{
 		if (has(e))
 		{
+			on_destroy.emit(e);
+
+			// Let the group move e out of its range first
+			if (owner != nullptr)
+				owner->on_remove(e);
+
 			// Get the current position
-			int cID = map_entity_componentID[e];
+			unsigned int* slot = find_slot(e);
+			unsigned int cID = *slot;
+			unsigned int last = (unsigned int)components.size() - 1;
 
 			// Move the last element to position cID using the move operator
 			// Note, components[cID] = components.back() would trigger the copy instead of move operator
-			components[cID] = std::move(components.back());
-			entities[cID] = entities.back(); // the entity is only a single index, copy it.
-			map_entity_componentID[entities.back()] = cID;
+			if (cID != last)
+			{
+				components[cID] = std::move(components.back());
+				entities[cID] = entities.back(); // the entity is only a single index, copy it.
+				versions[cID] = versions.back();
+				*find_slot(entities[cID]) = cID;
+			}
 
 			// Erase the old component and free its memory
-			map_entity_componentID.erase(e);
+			*slot = null_slot;
+			clear_signature_bit(e);
 			components.pop_back();
 			entities.pop_back();
-			// Note, one could mark the id for re-use
+			versions.pop_back();
 		}
 	};
 
+	// Remove the components of all entities in 'batch' (entities without one, and repeated ones, are skipped).
+	// Every entity is looked up once. An owning group moves all its members of the batch behind its
+	// range in one step, then the dense positions of the batch are marked and every position is filled
+	// with the last element that isn't marked itself, so the arrays are packed in a single pass.
+	void remove_batch(const std::vector<Entity>& batch)
+	{
+		batch_positions.clear();
+		if (batch_marks.size() < components.size())
+			batch_marks.resize(components.size(), 0);
+		// without listeners and a group nothing looks at the batch before it is gone, so the slots are
+		// released right away
+		bool release_now = on_destroy.empty() && owner == nullptr;
+		for (Entity e : batch)
+		{
+			unsigned int* slot = find_slot(e);
+			if (slot == nullptr || *slot == null_slot || (unsigned int)entities[*slot] != (unsigned int)e || batch_marks[*slot])
+				continue;
+			batch_marks[*slot] = 1;
+			batch_positions.push_back(*slot);
+			if (release_now)
+			{
+				*slot = null_slot;
+				clear_signature_bit(e);
+			}
+		}
+		if (batch_positions.empty())
+			return;
+
+		if (!release_now)
+		{
+			if (!on_destroy.empty())
+				for (unsigned int cID : batch_positions)
+					on_destroy.emit(entities[cID]);
+
+			// the group may move the batch, mark the positions again afterwards
+			if (owner != nullptr)
+			{
+				for (unsigned int cID : batch_positions)
+					batch_marks[cID] = 0;
+				owner->on_remove_batch(batch_positions);
+				for (unsigned int cID : batch_positions)
+					batch_marks[cID] = 1;
+			}
+
+			for (unsigned int cID : batch_positions)
+			{
+				*find_slot(entities[cID]) = null_slot;
+				clear_signature_bit(entities[cID]);
+			}
+		}
+
+		for (unsigned int cID : batch_positions)
+		{
+			// drop the marked elements at the back, this may include cID
+			while (!components.empty() && batch_marks[components.size() - 1])
+			{
+				batch_marks[components.size() - 1] = 0;
+				pop_back();
+			}
+			if (cID >= components.size() || !batch_marks[cID])
+				continue;
+			batch_marks[cID] = 0;
+			components[cID] = std::move(components.back());
+			entities[cID] = entities.back();
+			versions[cID] = versions.back();
+			*find_slot(entities[cID]) = cID;
+			pop_back();
+		}
+	}
+
+	// Calls func(Entity) for every entity with a component, in the order of the dense arrays
+	template <typename Func>
+	void each_entity(Func func)
+	{
+		for (size_t i = 0; i < entities.size(); i++)
+			func(entities[i]);
+	}
+
 	// Remove all components of type 'Component'
 	void clear()
 	{
-		map_entity_componentID.clear();
+		if (!on_destroy.empty())
+			for (Entity e : entities)
+				on_destroy.emit(e);
+		if (owner != nullptr)
+			owner->on_clear();
+		// Reset only the used sparse slots, the pages themselves are kept for re-use
+		for (Entity e : entities)
+		{
+			*find_slot(e) = null_slot;
+			clear_signature_bit(e);
+		}
 		components.clear();
 		entities.clear();
+		versions.clear();
 	}
 
 	// Report the number of components of type 'Component'
@@ -120,18 +799,918 @@ public:
 		return components.size();
 	}
 
+	// Write the dense arrays to a snapshot
+	void save(SnapshotWriter& writer) const
+	{
+		writer.write_array(entities);
+		writer.write_array(components);
+	}
+
+	// Replace the content with the dense arrays of a snapshot, copied in bulk. Only the sparse slots
+	// and signature bits are rebuilt per entity; an owning group has to refresh() afterwards.
+	bool load(SnapshotReader& reader)
+	{
+		clear();
+		size_t entity_count, component_count;
+		const Entity* stored_entities = reader.read_array<Entity>(entity_count);
+		const Component* stored_components = reader.read_array<Component>(component_count);
+		if (!reader.ok() || entity_count != component_count)
+			return false;
+		entities.assign(stored_entities, stored_entities + entity_count);
+		components.assign(stored_components, stored_components + component_count);
+		versions.assign(component_count, current_version); // everything counts as changed
+		high_water = std::max(high_water, components.size());
+		// in insertion order, so that for duplicates the slot refers to the last one again
+		for (unsigned int i = 0; i < entities.size(); i++)
+		{
+			assure_slot(entities[i]) = i;
+			set_signature_bit(entities[i]);
+		}
+		if (!on_construct.empty())
+			for (Entity e : entities)
+				on_construct.emit(e);
+		return true;
+	}
+
+	// Position of the component of entity e in the dense arrays
+	unsigned int index_of(Entity e)
+	{
+		assert(has(e) && "Entity not contained in ECS registry");
+		return *find_slot(e);
+	}
+
+	// Bytes used and reserved by this container
+	ContainerMemory memory() const
+	{
+		ContainerMemory memory;
+		memory.type_name = typeid(Component).name();
+		memory.size = components.size();
+		memory.capacity = components.capacity();
+		memory.high_water = high_water;
+		const size_t element_bytes = sizeof(Component) + sizeof(Entity) + sizeof(unsigned int);
+		memory.used_bytes = components.size() * element_bytes;
+		memory.reserved_bytes = components.capacity() * sizeof(Component) + entities.capacity() * sizeof(Entity) + versions.capacity() * sizeof(unsigned int);
+		memory.index_bytes = sparse_pages.capacity() * sizeof(sparse_pages[0]);
+		for (const std::unique_ptr<unsigned int[]>& page : sparse_pages)
+			if (page)
+			{
+				memory.index_pages++;
+				memory.index_bytes += sparse_page_size * sizeof(unsigned int);
+			}
+		if (memory.index_pages > 0)
+			memory.index_load = (float)components.size() / (float)(memory.index_pages * sparse_page_size);
+		memory.scratch_bytes = batch_positions.capacity() * sizeof(unsigned int) + batch_marks.capacity();
+		for (int b = 0; b < 2; b++)
+			memory.scratch_bytes += (radix_keys[b].capacity() + radix_order[b].capacity()) * sizeof(unsigned int);
+		return memory;
+	}
+
+	// Change tracking. A system remembers the checkpoint() of its last run and processes only the
+	// components that changed since, e.g.:
+	//   unsigned int since = last_seen; last_seen = container.checkpoint();
+	//   container.each_changed_since(since, ...);
+	// Changes are recorded by insert() and get(); writes through the dense arrays, views or groups
+	// have to call mark_changed() themselves.
+
+	// Returns the current version and starts a new one, later changes are newer than the returned version
+	unsigned int checkpoint()
+	{
+		return current_version++;
+	}
+
+	void mark_changed(Entity e)
+	{
+		assert(has(e) && "Entity not contained in ECS registry");
+		versions[*find_slot(e)] = current_version;
+		on_update.emit(e);
+	}
+
+	bool changed_since(Entity e, unsigned int version)
+	{
+		return versions[index_of(e)] > version;
+	}
+
+	// Calls func(Entity, Component&) for every component that changed after 'version' (doesn't mark them again)
+	template <typename Func>
+	void each_changed_since(unsigned int version, Func func)
+	{
+		for (unsigned int i = 0; i < components.size(); i++)
+			if (versions[i] > version)
+				func(entities[i], components[i]);
+	}
+
+	// Exchange the components (and entities) at two positions of the dense arrays
+	void swap_positions(unsigned int i, unsigned int j)
+	{
+		if (i == j)
+			return;
+		std::swap(components[i], components[j]);
+		std::swap(entities[i], entities[j]);
+		std::swap(versions[i], versions[j]);
+		*find_slot(entities[i]) = i;
+		*find_slot(entities[j]) = j;
+	}
+
 	// Sort the components and associated entity assignment structures by the comparisonFunction, see std::sort
+	// The positions are sorted first, so comparisonFunction may still look components up with read()
+	// (get() would mark every compared component as changed and fire on_update),
+	// then components and entities are moved in place along the cycles of the permutation.
+	// The scratch buffer is kept between calls, so sorting every frame doesn't allocate.
+	// Note, don't sort containers with duplicates.
 	template <class Compare>
 	void sort(Compare comparisonFunction)
 	{
-		// First sort the entity list as desired
-		std::sort(entities.begin(), entities.end(), comparisonFunction);
-		// Now re-arrange the components (Note, creates a new vector, which may be slow! Not sure if in-place could be faster: https://stackoverflow.com/questions/63703637/how-to-efficiently-permute-an-array-in-place-using-stdswap)
-		std::vector<Component> components_new; components_new.reserve(components.size());
-		std::transform(entities.begin(), entities.end(), std::back_inserter(components_new), [&](Entity e) { return std::move(get(e)); }); // note, the get still uses the old hash map (on purpose!)
-		components = std::move(components_new); // note, we use move operations to not create unneccesary copies of objects, but memory is still allocated for the new vector
-		// Fill the new hashmap
-		for (unsigned int i = 0; i < entities.size(); i++)
-			map_entity_componentID[entities[i]] = i;
+		assert(owner == nullptr && "The order of containers owned by a group can't be changed");
+		std::vector<unsigned int>& order = radix_order[0];
+		order.resize(entities.size());
+		for (unsigned int i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+			return comparisonFunction(entities[a], entities[b]);
+		});
+		permute(order);
+	}
+
+	// Stable sort by an unsigned integer key, key(Entity, const Component&) -> unsigned int, e.g., a
+	// texture id or a grid cell. An LSD radix sort over 8 bit digits, linear in the number of components.
+	// Digits that are equal for all keys are skipped, so small keys take one or two passes. The scratch
+	// buffers are kept between calls and only grow. Note, don't sort containers with duplicates.
+	template <class Key>
+	void sort_by_key(Key key)
+	{
+		assert(owner == nullptr && "The order of containers owned by a group can't be changed");
+		unsigned int n = (unsigned int)components.size();
+		for (int b = 0; b < 2; b++)
+		{
+			radix_keys[b].resize(n);
+			radix_order[b].resize(n);
+		}
+		for (unsigned int i = 0; i < n; i++)
+		{
+			radix_keys[0][i] = key(entities[i], static_cast<const Component&>(components[i]));
+			radix_order[0][i] = i;
+		}
+
+		int source = 0;
+		for (unsigned int shift = 0; shift < 32; shift += 8)
+		{
+			unsigned int histogram[256] = {};
+			for (unsigned int i = 0; i < n; i++)
+				histogram[(radix_keys[source][i] >> shift) & 0xFF]++;
+			if (n == 0 || histogram[(radix_keys[source][0] >> shift) & 0xFF] == n)
+				continue; // all keys share this digit
+			unsigned int offset = 0;
+			for (unsigned int& count : histogram)
+			{
+				unsigned int c = count;
+				count = offset;
+				offset += c;
+			}
+			for (unsigned int i = 0; i < n; i++)
+			{
+				unsigned int to = histogram[(radix_keys[source][i] >> shift) & 0xFF]++;
+				radix_keys[1 - source][to] = radix_keys[source][i];
+				radix_order[1 - source][to] = radix_order[source][i];
+			}
+			source = 1 - source;
+		}
+		permute(radix_order[source]);
+	}
+
+private:
+	// Scratch space of sort and sort_by_key
+	std::vector<unsigned int> radix_keys[2];
+	std::vector<unsigned int> radix_order[2];
+
+	// Move the element at position order[i] to position i for all i, in place along the cycles of
+	// the permutation. 'order' is used to mark finished positions and is the identity afterwards.
+	void permute(std::vector<unsigned int>& order)
+	{
+		for (unsigned int i = 0; i < order.size(); i++)
+		{
+			if (order[i] == i)
+				continue;
+			Component first_component = std::move(components[i]);
+			Entity first_entity = entities[i];
+			unsigned int first_version = versions[i];
+			unsigned int current = i;
+			while (order[current] != i)
+			{
+				unsigned int next = order[current];
+				components[current] = std::move(components[next]);
+				entities[current] = entities[next];
+				versions[current] = versions[next];
+				*find_slot(entities[current]) = current;
+				order[current] = current;
+				current = next;
+			}
+			components[current] = std::move(first_component);
+			entities[current] = first_entity;
+			versions[current] = first_version;
+			*find_slot(first_entity) = current;
+			order[current] = current;
+		}
+	}
+};
+
+// Out-of-class definitions, needed when the constants are bound to references (e.g. std::fill_n)
+template <typename Component, typename Enable> const unsigned int ComponentContainer<Component, Enable>::sparse_page_size;
+template <typename Component, typename Enable> const unsigned int ComponentContainer<Component, Enable>::null_slot;
+
+// Tag components (empty structs such as Player or Deadly) carry no data, so they are stored as a
+// bitset over Entity::index() instead of component/entity arrays and a sparse index: has() is a
+// single bit test and iteration walks the set bits. get() returns a shared (empty) instance.
+template <typename Component>
+class ComponentContainer<Component, typename std::enable_if<std::is_empty<Component>::value>::type>
+{
+public:
+	typedef Component component_type;
+
+private:
+	typedef unsigned long long Word;
+	static const unsigned int word_bits = 64;
+
+	// Bit i is set if the entity in slot i has the tag
+	std::vector<Word> bits;
+	size_t count = 0;
+	size_t high_water = 0;
+
+	// The per-entity signatures of the registry (if any) and the bit that stands for this container
+	std::vector<Signature>* signatures = nullptr;
+	Signature signature_bit = 0;
+
+	bool test(unsigned int index) const
+	{
+		return index / word_bits < bits.size() && (bits[index / word_bits] >> (index % word_bits)) & 1u;
+	}
+
+public:
+	// Iterates the tagged entities in the order of their index
+	class iterator
+	{
+		const std::vector<Word>* bits;
+		size_t word;
+		Word remaining; // the not yet visited bits of the current word
+
+		void skip_empty_words()
+		{
+			while (remaining == 0 && word < bits->size())
+				if (++word < bits->size())
+					remaining = (*bits)[word];
+		}
+	public:
+		iterator(const std::vector<Word>* bits, size_t word) : bits(bits), word(word), remaining(word < bits->size() ? (*bits)[word] : 0)
+		{
+			skip_empty_words();
+		}
+		Entity operator*() const
+		{
+			unsigned int bit = 0;
+			while (((remaining >> bit) & 1u) == 0)
+				bit++;
+			return Entity::from_index((unsigned int)(word * word_bits + bit));
+		}
+		iterator& operator++()
+		{
+			remaining &= remaining - 1; // clear the lowest set bit
+			skip_empty_words();
+			return *this;
+		}
+		bool operator!=(const iterator& other) const
+		{
+			return word != other.word || remaining != other.remaining;
+		}
+	};
+
+	// Lifecycle signals, see the general container (tags carry no data, so there is no on_update)
+	Signal on_construct;
+	Signal on_destroy;
+
+	ComponentContainer()
+	{
+	}
+
+	void bind_signature(std::vector<Signature>* registry_signatures, Signature bit)
+	{
+		signatures = registry_signatures;
+		signature_bit = bit;
+	}
+
+	Signature signature_mask() const
+	{
+		return signature_bit;
+	}
+
+	// Tag entity e, the component itself carries no data
+	inline Component& insert(Entity e, Component, bool check_for_duplicates = true)
+	{
+		assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
+		if (!has(e))
+		{
+			if (e.index() / word_bits >= bits.size())
+				bits.resize(e.index() / word_bits + 1, 0);
+			bits[e.index() / word_bits] |= Word(1) << (e.index() % word_bits);
+			count++;
+			high_water = std::max(high_water, count);
+			if (signatures != nullptr)
+			{
+				if (e.index() >= signatures->size())
+					signatures->resize(e.index() + 1, 0);
+				(*signatures)[e.index()] |= signature_bit;
+			}
+			on_construct.emit(e);
+		}
+		return get(e);
+	}
+
+	template<typename... Args>
+	Component& emplace(Entity e, Args &&... args) {
+		return insert(e, Component(std::forward<Args>(args)...));
+	};
+
+	// Tag all 'count' entities
+	void insert_n(const Entity* new_entities, size_t count, const Component& prototype)
+	{
+		if (count > 0)
+		{
+			unsigned int highest = 0;
+			for (size_t i = 0; i < count; i++)
+				highest = std::max(highest, new_entities[i].index());
+			reserve(highest + 1);
+		}
+		for (size_t i = 0; i < count; i++)
+			insert(new_entities[i], prototype);
+	}
+
+	// Make room for the entities with an index below n
+	void reserve(size_t n)
+	{
+		if ((n + word_bits - 1) / word_bits > bits.size())
+			bits.resize((n + word_bits - 1) / word_bits, 0);
+	}
+
+	// All tags are interchangeable, so every entity shares the same instance
+	Component& get(Entity e) {
+		assert(has(e) && "Entity not contained in ECS registry");
+		(void)e;
+		static Component tag;
+		return tag;
+	}
+	Component& at(Entity e) {
+		return get(e);
+	}
+
+	// Note, the generation check rejects stale handles whose slot was re-used by a tagged entity
+	bool has(Entity entity) {
+		return test(entity.index()) && Entity::is_alive(entity);
+	}
+
+	void remove(Entity e)
+	{
+		if (has(e))
+		{
+			on_destroy.emit(e);
+			bits[e.index() / word_bits] &= ~(Word(1) << (e.index() % word_bits));
+			count--;
+			if (signatures != nullptr)
+				(*signatures)[e.index()] &= ~signature_bit;
+		}
+	}
+
+	// Untag all entities of 'batch', the signatures are only touched if the container is part of a registry
+	void remove_batch(const std::vector<Entity>& batch)
+	{
+		for (Entity e : batch)
+		{
+			size_t word = e.index() / word_bits;
+			Word bit = Word(1) << (e.index() % word_bits);
+			if (word >= bits.size() || !(bits[word] & bit) || !Entity::is_alive(e))
+				continue;
+			if (!on_destroy.empty())
+				on_destroy.emit(e);
+			bits[word] &= ~bit;
+			count--;
+			if (signatures != nullptr)
+				(*signatures)[e.index()] &= ~signature_bit;
+		}
+	}
+
+	// Calls func(Entity) for every tagged entity
+	template <typename Func>
+	void each_entity(Func func)
+	{
+		for (Entity e : *this)
+			func(e);
+	}
+
+	iterator begin() const { return iterator(&bits, 0); }
+	iterator end() const { return iterator(&bits, bits.size()); }
+
+	// The tagged entity with the lowest index, e.g., the player
+	Entity front() const
+	{
+		assert(count > 0 && "No entity has this tag");
+		return *begin();
+	}
+
+	void clear()
+	{
+		for (Entity e : *this)
+		{
+			on_destroy.emit(e);
+			if (signatures != nullptr)
+				(*signatures)[e.index()] &= ~signature_bit;
+		}
+		std::fill(bits.begin(), bits.end(), Word(0));
+		count = 0;
+	}
+
+	size_t size()
+	{
+		return count;
+	}
+
+	// Bytes used by the bitset, a tag container has no dense arrays
+	ContainerMemory memory() const
+	{
+		ContainerMemory memory;
+		memory.type_name = typeid(Component).name();
+		memory.size = count;
+		memory.capacity = bits.size() * word_bits;
+		memory.high_water = high_water;
+		memory.index_bytes = bits.capacity() * sizeof(Word);
+		if (!bits.empty())
+			memory.index_load = (float)count / (float)(bits.size() * word_bits);
+		return memory;
+	}
+
+	// Write the bitset to a snapshot
+	void save(SnapshotWriter& writer) const
+	{
+		writer.write_array(bits.data(), bits.size());
+	}
+
+	// Replace the tags with the bitset of a snapshot
+	bool load(SnapshotReader& reader)
+	{
+		clear();
+		size_t word_count;
+		const Word* stored_bits = reader.read_array<Word>(word_count);
+		if (!reader.ok())
+			return false;
+		bits.assign(stored_bits, stored_bits + word_count);
+		for (Entity e : *this)
+		{
+			count++;
+			if (signatures != nullptr)
+			{
+				if (e.index() >= signatures->size())
+					signatures->resize(e.index() + 1, 0);
+				(*signatures)[e.index()] |= signature_bit;
+			}
+			on_construct.emit(e);
+		}
+		high_water = std::max(high_water, count);
+		return true;
+	}
+};
+
+// One container per component type, stored in a tuple so that every per-type operation of the
+// registry is resolved at compile time instead of through a list of base class pointers.
+// Bit i of a Signature stands for the i-th type of 'Component...'.
+template <typename... Component>
+class ComponentStorage
+{
+	std::tuple<ComponentContainer<Component>...> containers;
+
+	template <typename Func, size_t... I>
+	void each_impl(Func& func, std::index_sequence<I...>)
+	{
+		using expand = int[];
+		(void)expand{ 0, (func(std::get<I>(containers)), 0)... };
+	}
+
+	template <typename Func, size_t... I>
+	void each_in_impl(Signature mask, Func& func, std::index_sequence<I...>)
+	{
+		using expand = int[];
+		(void)expand{ 0, ((mask & (1u << I)) ? (func(std::get<I>(containers)), 0) : 0)... };
+	}
+
+public:
+	static const unsigned int type_count = sizeof...(Component);
+	static_assert(sizeof...(Component) <= 8 * sizeof(Signature), "Too many component types for the signature bitmask");
+
+	// The container of component type T, a compile error if T is not part of 'Component...'
+	template <typename T>
+	ComponentContainer<T>& get()
+	{
+		return std::get<type_index_in<T, Component...>::value>(containers);
+	}
+
+	// The signature bit of component type T
+	template <typename T>
+	static constexpr Signature bit()
+	{
+		return 1u << type_index_in<T, Component...>::value;
+	}
+
+	// Calls func(container) for every container, func is typically a generic lambda
+	template <typename Func>
+	void each(Func func)
+	{
+		each_impl(func, std::index_sequence_for<Component...>());
+	}
+
+	// Calls func(container) for every container whose bit is set in 'mask'
+	template <typename Func>
+	void each_in(Signature mask, Func func)
+	{
+		each_in_impl(mask, func, std::index_sequence_for<Component...>());
+	}
+};
+
+template <typename... Component>
+const unsigned int ComponentStorage<Component...>::type_count;
+
+// Whether a context resource is saved and restored by registry snapshots, specialize as std::false_type
+// for resources that have to keep running across a load, e.g., clocks
+template <typename Resource>
+struct context_in_snapshot : std::true_type {};
+
+// Singleton resources of a registry (screen state, frame clock, ...), exactly one instance per type.
+// They are not attached to an entity, and access is a fixed offset into a tuple without any lookup.
+template <typename... Resource>
+class ContextStorage
+{
+	std::tuple<Resource...> resources;
+
+	template <typename Func, size_t... I>
+	void each_impl(Func& func, std::index_sequence<I...>)
+	{
+		using expand = int[];
+		(void)expand{ 0, (func(std::get<I>(resources)), 0)... };
+	}
+
+	template <typename Func, size_t... I>
+	void each_in_snapshot_impl(Func& func, std::index_sequence<I...>)
+	{
+		using expand = int[];
+		(void)expand{ 0, (context_in_snapshot<Resource>::value ? (func(std::get<I>(resources)), 0) : 0)... };
+	}
+
+public:
+	// The resource of type T, a compile error if T is not part of 'Resource...'
+	template <typename T>
+	T& get()
+	{
+		return std::get<type_index_in<T, Resource...>::value>(resources);
+	}
+
+	// Calls func(resource) for every resource
+	template <typename Func>
+	void each(Func func)
+	{
+		each_impl(func, std::index_sequence_for<Resource...>());
+	}
+
+	// Calls func(resource) for every resource that is part of snapshots, see context_in_snapshot
+	template <typename Func>
+	void each_in_snapshot(Func func)
+	{
+		each_in_snapshot_impl(func, std::index_sequence_for<Resource...>());
+	}
+};
+
+// Tag listing component types that entities of a view must NOT have, e.g., registry.view<Motion>(exclude<Player>)
+template <typename... Component>
+struct exclude_t {};
+template <typename... Component>
+constexpr exclude_t<Component...> exclude{};
+
+// A view iterates all entities that have every 'Component' and none of the excluded types.
+// It walks the entities of the smallest included container and hands references to all requested
+// components to the callback, so systems don't have to look every component up themselves.
+// Note, don't add or remove components of the viewed types inside each(), the dense arrays are re-packed on removal.
+// Views don't track changes, systems that write through a view call mark_changed() themselves.
+template <typename Exclude, typename... Component>
+class View;
+
+template <typename... Excluded, typename... Component>
+class View<exclude_t<Excluded...>, Component...>
+{
+	std::tuple<ComponentContainer<Component>*...> included;
+	std::tuple<ComponentContainer<Excluded>*...> excluded;
+
+	// Position of the container in 'Component...' that drives the iteration
+	size_t driver = 0;
+
+	// Helper to expand an expression over a parameter pack (C++14 has no fold expressions)
+	using expand = int[];
+
+	// Check the entity against all included and excluded containers
+	bool contains(Entity e) const
+	{
+		bool result = true;
+		(void)expand{ 0, (result = result && std::get<ComponentContainer<Component>*>(included)->has(e), 0)... };
+		(void)expand{ 0, (result = result && !std::get<ComponentContainer<Excluded>*>(excluded)->has(e), 0)... };
+		return result;
+	}
+
+	template <typename Container, typename Func>
+	void each_of(Container& container, Func& func)
+	{
+		container.each_entity([&](Entity e) {
+			if (contains(e))
+				func(e, std::get<ComponentContainer<Component>*>(included)->at(e)...);
+		});
+	}
+
+	template <typename Func, size_t... I>
+	void each_driven(Func& func, std::index_sequence<I...>)
+	{
+		(void)expand{ 0, (driver == I ? (each_of(*std::get<I>(included), func), 0) : 0)... };
+	}
+
+public:
+	View(std::tuple<ComponentContainer<Component>*...> included, std::tuple<ComponentContainer<Excluded>*...> excluded)
+		: included(included), excluded(excluded)
+	{
+		// Iterate the smallest container, every other container is only probed
+		size_t sizes[] = { std::get<ComponentContainer<Component>*>(included)->size()... };
+		for (size_t i = 1; i < sizeof...(Component); i++)
+			if (sizes[i] < sizes[driver])
+				driver = i;
+	}
+
+	// Force iteration over the container of type T, e.g., to visit entities in the order of that container
+	template <typename T>
+	View& use()
+	{
+		driver = type_index_in<T, Component...>::value;
+		return *this;
+	}
+
+	// An upper bound for the number of entities in the view
+	size_t size_hint() const
+	{
+		size_t sizes[] = { std::get<ComponentContainer<Component>*>(included)->size()... };
+		return sizes[driver];
+	}
+
+	// Calls func(Entity, Component&...) for every entity in the view
+	template <typename Func>
+	void each(Func func)
+	{
+		each_driven(func, std::index_sequence_for<Component...>());
+	}
+};
+
+// An owning group keeps the entities that have both an 'A' and a 'B' component at the front of
+// both containers, in the same order. Position i < size() of both dense arrays then belongs to the
+// same entity, so systems that need both components walk two arrays in lockstep instead of looking
+// one of them up per entity. The order is kept up to date as components are inserted and removed.
+// Note, a container can only be owned by one group and owned containers can't be sorted.
+template <typename A, typename B>
+class OwningGroup : public GroupInterface
+{
+	ComponentContainer<A>& a;
+	ComponentContainer<B>& b;
+	unsigned int length = 0;
+	std::vector<bool> leaving; // scratch space of on_remove_batch
+
+public:
+	OwningGroup(ComponentContainer<A>& a, ComponentContainer<B>& b) : a(a), b(b)
+	{
+		assert(a.owner == nullptr && b.owner == nullptr && "Container is already owned by another group");
+		a.owner = this;
+		b.owner = this;
+		// adopt the entities that are already in both containers
+		refresh();
+	}
+
+	~OwningGroup()
+	{
+		a.owner = nullptr;
+		b.owner = nullptr;
+	}
+
+	OwningGroup(const OwningGroup&) = delete;
+	OwningGroup& operator=(const OwningGroup&) = delete;
+
+	void on_insert(Entity e)
+	{
+		if (a.has(e) && b.has(e) && a.index_of(e) >= length)
+		{
+			a.swap_positions(a.index_of(e), length);
+			b.swap_positions(b.index_of(e), length);
+			length++;
+		}
+	}
+
+	void on_remove(Entity e)
+	{
+		if (a.has(e) && b.has(e) && a.index_of(e) < length)
+		{
+			length--;
+			a.swap_positions(a.index_of(e), length);
+			b.swap_positions(b.index_of(e), length);
+		}
+	}
+
+	// The group range is at the same positions in both containers, so the positions of either one
+	// tell which entities are group members. The members at the front of the range are swapped with
+	// the members at the end of the range that stay, in both containers, and the range shrinks once.
+	void on_remove_batch(std::vector<unsigned int>& positions)
+	{
+		unsigned int removed = 0;
+		for (unsigned int position : positions)
+			removed += position < length ? 1 : 0;
+		if (removed == 0)
+			return;
+		unsigned int new_length = length - removed;
+
+		// members of the batch that are already behind the new end stay where they are
+		leaving.assign(removed, false);
+		for (unsigned int position : positions)
+			if (position >= new_length && position < length)
+				leaving[position - new_length] = true;
+
+		unsigned int kept = new_length;
+		for (unsigned int& position : positions)
+		{
+			if (position >= new_length)
+				continue;
+			while (leaving[kept - new_length])
+				kept++;
+			a.swap_positions(position, kept);
+			b.swap_positions(position, kept);
+			position = kept++;
+		}
+		length = new_length;
+	}
+
+	void on_clear()
+	{
+		length = 0;
+	}
+
+	// Re-establish the group after the owned containers were loaded without notifying it, see ECSRegistry::load_snapshot
+	void refresh()
+	{
+		length = 0;
+		for (unsigned int i = 0; i < a.size(); i++)
+			on_insert(a.entities[i]);
+	}
+
+	// Number of entities that have both components
+	size_t size() const
+	{
+		return length;
+	}
+
+	// Calls func(Entity, A&, B&) for every entity of the group, walking both containers in lockstep
+	template <typename Func>
+	void each(Func func)
+	{
+		for (unsigned int i = 0; i < length; i++)
+			func(a.entities[i], a.components[i], b.components[i]);
+	}
+};
+
+// The commands recorded for one component type: the entity, and the component to add or 'remove_command'
+template <typename Component>
+struct ComponentCommands
+{
+	static const unsigned int remove_command = ~0u;
+
+	struct Record
+	{
+		Entity e;
+		unsigned int sequence; // position in the recording order
+		unsigned int value; // index into 'values', or remove_command
+	};
+
+	std::vector<Record> records;
+	std::vector<Component> values;
+
+	// Scratch space of apply, kept to not allocate on every flush
+	std::vector<Entity> removals;
+	std::vector<Record> inserts;
+
+	// Sort the commands by entity and apply them in one removal batch followed by the inserts.
+	// Only the last command recorded for an entity counts, an emplace replaces an existing component.
+	void apply(ComponentContainer<Component>& container)
+	{
+		if (records.empty())
+			return;
+		std::sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+			return (unsigned int)a.e != (unsigned int)b.e ? (unsigned int)a.e < (unsigned int)b.e : a.sequence < b.sequence;
+		});
+		removals.clear();
+		inserts.clear();
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			const Record& last = records[i];
+			if (i + 1 < records.size() && records[i + 1].e == last.e)
+				continue;
+			if (last.value != remove_command && !Entity::is_alive(last.e))
+				continue;
+			if (container.has(last.e))
+				removals.push_back(last.e);
+			if (last.value != remove_command)
+				inserts.push_back(last);
+		}
+		container.remove_batch(removals);
+		for (const Record& insert : inserts)
+			container.insert(insert.e, std::move(values[insert.value]));
+		clear();
+	}
+
+	void clear()
+	{
+		records.clear();
+		values.clear();
+	}
+};
+
+template <typename Component>
+const unsigned int ComponentCommands<Component>::remove_command;
+
+// Records structural changes (new and removed components) while systems iterate over the containers,
+// so they can be applied later at a sync point, see ECSRegistry::flush. Each component type keeps its
+// own typed records, which are applied container by container, sorted by entity.
+// Entities are removed as a whole with ECSRegistry::remove_deferred instead.
+template <typename Storage>
+class CommandBuffer;
+
+template <typename... Component>
+class CommandBuffer<ComponentStorage<Component...>>
+{
+	std::tuple<ComponentCommands<Component>...> queues;
+	unsigned int count = 0;
+
+	template <size_t... I>
+	void apply_impl(ComponentStorage<Component...>& storage, std::index_sequence<I...>)
+	{
+		using expand = int[];
+		(void)expand{ 0, (std::get<I>(queues).apply(storage.template get<Component>()), 0)... };
+	}
+
+	template <size_t... I>
+	void clear_impl(std::index_sequence<I...>)
+	{
+		using expand = int[];
+		(void)expand{ 0, (std::get<I>(queues).clear(), 0)... };
+	}
+
+	template <typename T>
+	ComponentCommands<T>& queue()
+	{
+		return std::get<type_index_in<T, Component...>::value>(queues);
+	}
+
+public:
+	// Reserve a new entity right away, its components can then be added with emplace()
+	Entity create()
+	{
+		return Entity();
+	}
+
+	// Add a component to e once the buffer is applied, e.g., commands.emplace<LightUp>(e)
+	template <typename T, typename... Args>
+	void emplace(Entity e, Args &&... args)
+	{
+		ComponentCommands<T>& commands = queue<T>();
+		commands.records.push_back({ e, count++, (unsigned int)commands.values.size() });
+		commands.values.emplace_back(std::forward<Args>(args)...);
+	}
+
+	// Remove a component from e once the buffer is applied, e.g., commands.remove<LightUp>(e)
+	template <typename T>
+	void remove(Entity e)
+	{
+		queue<T>().records.push_back({ e, count++, ComponentCommands<T>::remove_command });
+	}
+
+	// Apply all recorded commands to the containers of 'storage' and empty the buffer
+	void apply(ComponentStorage<Component...>& storage)
+	{
+		if (count == 0)
+			return;
+		apply_impl(storage, std::index_sequence_for<Component...>());
+		count = 0;
+	}
+
+	bool empty() const
+	{
+		return count == 0;
+	}
+
+	// Drop all recorded commands without running them
+	void clear()
+	{
+		clear_impl(std::index_sequence_for<Component...>());
+		count = 0;
 	}
 };
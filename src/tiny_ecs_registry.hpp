@@ -1,82 +1,380 @@
 #pragma once
 #include <vector>
+#include <cstdio>
 
 #include "tiny_ecs.hpp"
 #include "components.hpp"
 
+// The frame clock keeps counting across snapshot loads, restarting a level doesn't rewind time
+template <>
+struct context_in_snapshot<FrameClock> : std::false_type {};
+
 class ECSRegistry
 {
-	// Callbacks to remove a particular or all entities in the system
-	std::vector<ContainerInterface*> registry_list;
+	// All containers of this game, one per component type
+	// TODO: A1 add a LightUp component
+	ComponentStorage<
+		DeathTimer,
+		Motion,
+		Collision,
+		Player,
+		Mesh*,
+		RenderRequest,
+		Eatable,
+		Deadly,
+		DebugComponent,
+		vec3,
+		LightUp,
+		Attractor,
+		Object,
+		Collider,
+		BoundingBox,
+		BoundingLine,
+		PendingRemove,
+		Relationship,
+		Pooled
+	> storage;
+
+	// The entities removed by the current flush() or destroy_n(), kept to re-use its memory
+	std::vector<Entity> removal_batch;
+	std::vector<unsigned char> in_removal_batch; // by Entity::index()
+
+	// Component signature of every entity, indexed by Entity::index(). Bit i is set if the entity
+	// has a component of the i-th type of 'storage'; the containers keep their bit up to date.
+	std::vector<Signature> signatures;
+
+	// Global per-frame state that belongs to no entity, see ctx()
+	ContextStorage<
+		ScreenState,
+		FrameClock,
+		CollisionFilter
+	> context;
+
+	// Identifies the snapshot format and the component layout it was written with
+	void write_snapshot_header(SnapshotWriter& writer) {
+		const unsigned int snapshot_version = 2;
+		writer.write(snapshot_version);
+		writer.write(storage.type_count);
+		storage.each([&](auto& container) {
+			writer.write((unsigned int)sizeof(typename std::decay<decltype(container)>::type::component_type));
+		});
+		context.each_in_snapshot([&](auto& resource) { writer.write((unsigned int)sizeof(resource)); });
+	}
 
 public:
-	// Manually created list of all components this game has
-	// TODO: A1 add a LightUp component
-	ComponentContainer<DeathTimer> deathTimers;
-	ComponentContainer<Motion> motions;
-	ComponentContainer<Collision> collisions;
-	ComponentContainer<Player> players;
-	ComponentContainer<Mesh*> meshPtrs;
-	ComponentContainer<RenderRequest> renderRequests;
-	ComponentContainer<ScreenState> screenStates;
-	ComponentContainer<Eatable> eatables;
-	ComponentContainer<Deadly> deadlys;
-	ComponentContainer<DebugComponent> debugComponents;
-	ComponentContainer<vec3> colors;
-	ComponentContainer<LightUp> lightUps;
-	ComponentContainer<Attractor> attractors;
-	ComponentContainer<Object> objects;
-	ComponentContainer<BoundingBox> boundingBoxes;
-	ComponentContainer<BoundingLine> boundingLines;
-	ComponentContainer<PendingRemove> pendingRemoves;
-
-	// constructor that adds all containers for looping over them
-	// IMPORTANT: Don't forget to add any newly added containers!
+	// Named access to the containers. A component type has to be part of 'storage' to get a
+	// container, so there is no separate list that could be forgotten.
+	ComponentContainer<DeathTimer>& deathTimers = storage.get<DeathTimer>();
+	ComponentContainer<Motion>& motions = storage.get<Motion>();
+	ComponentContainer<Collision>& collisions = storage.get<Collision>();
+	ComponentContainer<Player>& players = storage.get<Player>();
+	ComponentContainer<Mesh*>& meshPtrs = storage.get<Mesh*>();
+	ComponentContainer<RenderRequest>& renderRequests = storage.get<RenderRequest>();
+	ComponentContainer<Eatable>& eatables = storage.get<Eatable>();
+	ComponentContainer<Deadly>& deadlys = storage.get<Deadly>();
+	ComponentContainer<DebugComponent>& debugComponents = storage.get<DebugComponent>();
+	ComponentContainer<vec3>& colors = storage.get<vec3>();
+	ComponentContainer<LightUp>& lightUps = storage.get<LightUp>();
+	ComponentContainer<Attractor>& attractors = storage.get<Attractor>();
+	ComponentContainer<Object>& objects = storage.get<Object>();
+	ComponentContainer<Collider>& colliders = storage.get<Collider>();
+	ComponentContainer<BoundingBox>& boundingBoxes = storage.get<BoundingBox>();
+	ComponentContainer<BoundingLine>& boundingLines = storage.get<BoundingLine>();
+	ComponentContainer<PendingRemove>& pendingRemoves = storage.get<PendingRemove>();
+	ComponentContainer<Relationship>& relationships = storage.get<Relationship>();
+	ComponentContainer<Pooled>& pooled = storage.get<Pooled>();
+
+	// Motion and Object are always used together, keep them packed in the same order
+	OwningGroup<Motion, Object> motionObjects;
+
+	// Component changes recorded by systems while they iterate, applied by flush()
+	CommandBuffer<decltype(storage)> commands;
+
+	// constructor that binds every container to its signature bit
 	ECSRegistry()
+		: motionObjects(motions, objects)
 	{
-		// TODO: A1 add a LightUp component
-		registry_list.push_back(&deathTimers);
-		registry_list.push_back(&motions);
-		registry_list.push_back(&collisions);
-		registry_list.push_back(&players);
-		registry_list.push_back(&meshPtrs);
-		registry_list.push_back(&renderRequests);
-		registry_list.push_back(&screenStates);
-		registry_list.push_back(&eatables);
-		registry_list.push_back(&deadlys);
-		registry_list.push_back(&debugComponents);
-		registry_list.push_back(&colors);
-		registry_list.push_back(&lightUps);
-		registry_list.push_back(&attractors);
-		registry_list.push_back(&objects);	
-		registry_list.push_back(&boundingBoxes);
-		registry_list.push_back(&boundingLines);
-		registry_list.push_back(&pendingRemoves);
+		unsigned int i = 0;
+		storage.each([&](auto& container) { container.bind_signature(&signatures, 1u << i++); });
 	}
 
+	ECSRegistry(const ECSRegistry&) = delete;
+	ECSRegistry& operator=(const ECSRegistry&) = delete;
+
 	void clear_all_components() {
-		for (ContainerInterface* reg : registry_list)
-			reg->clear();
+		storage.each([](auto& container) { container.clear(); });
 	}
 
 	void list_all_components() {
 		printf("Debug info on all registry entries:\n");
-		for (ContainerInterface* reg : registry_list)
-			if (reg->size() > 0)
-				printf("%4d components of type %s\n", (int)reg->size(), typeid(*reg).name());
+		storage.each([](auto& container) {
+			if (container.size() > 0)
+				printf("%4d components of type %s\n", (int)container.size(), typeid(container).name());
+		});
+	}
+
+	// Memory use of every container
+	std::vector<ContainerMemory> memory_report() {
+		std::vector<ContainerMemory> report;
+		storage.each([&](auto& container) { report.push_back(container.memory()); });
+		return report;
+	}
+
+	// Write memory_report() as a single line of JSON, together with the entity slots and signatures
+	void write_memory_report(FILE* file, const char* event) {
+		size_t total_used = 0, total_reserved = 0;
+		fprintf(file, "{\"event\":\"%s\",\"entity_slots\":%zu,\"free_slots\":%zu,\"signature_bytes\":%zu,\"containers\":[",
+			event, Entity::capacity(), Entity::free_count(), signatures.capacity() * sizeof(Signature));
+		std::vector<ContainerMemory> report = memory_report();
+		for (size_t i = 0; i < report.size(); i++) {
+			const ContainerMemory& m = report[i];
+			fprintf(file, "%s{\"type\":\"%s\",\"size\":%zu,\"capacity\":%zu,\"high_water\":%zu,\"used_bytes\":%zu,\"reserved_bytes\":%zu,"
+				"\"index_bytes\":%zu,\"index_pages\":%zu,\"index_load\":%.4f,\"scratch_bytes\":%zu}",
+				i == 0 ? "" : ",", m.type_name, m.size, m.capacity, m.high_water, m.used_bytes, m.reserved_bytes,
+				m.index_bytes, m.index_pages, m.index_load, m.scratch_bytes);
+			total_used += m.used_bytes;
+			total_reserved += m.reserved_bytes + m.index_bytes + m.scratch_bytes;
+		}
+		fprintf(file, "],\"total_used_bytes\":%zu,\"total_reserved_bytes\":%zu}\n", total_used, total_reserved);
 	}
 
 	void list_all_components_of(Entity e) {
 		printf("Debug info on components of entity %u:\n", (unsigned int)e);
-		for (ContainerInterface* reg : registry_list)
-			if (reg->has(e))
-				printf("type %s\n", typeid(*reg).name());
+		storage.each_in(signature_of(e), [](auto& container) {
+			printf("type %s\n", typeid(container).name());
+		});
+	}
+
+	// The component signature of e, 0 for destroyed entities
+	Signature signature_of(Entity e) {
+		if (!Entity::is_alive(e) || e.index() >= signatures.size())
+			return 0;
+		return signatures[e.index()];
+	}
+
+	// The signature bits of the given component types, e.g., registry.mask<Motion, Object>()
+	template <typename... Component>
+	Signature mask() {
+		Signature mask = 0;
+		using expand = int[];
+		(void)expand{ 0, (mask |= storage.bit<Component>(), 0)... };
+		return mask;
+	}
+
+	// Check if e has all the given components with a single mask test, e.g., registry.has<Motion, Object>(e)
+	template <typename... Component>
+	bool has(Entity e) {
+		Signature required = mask<Component...>();
+		return (signature_of(e) & required) == required;
+	}
+
+	// The singleton resource of type T, e.g., registry.ctx<ScreenState>()
+	template <typename T>
+	T& ctx() {
+		return context.get<T>();
+	}
+
+	// Direct access to the container of component type T
+	template <typename T>
+	ComponentContainer<T>& container() {
+		return storage.get<T>();
+	}
+
+	// Iterate all entities with all Components and none of the Excluded types, e.g., registry.view<Motion, Object>(exclude<Player>)
+	template <typename... Component, typename... Excluded>
+	View<exclude_t<Excluded...>, Component...> view(exclude_t<Excluded...> = {})
+	{
+		return View<exclude_t<Excluded...>, Component...>(
+			std::make_tuple(&container<Component>()...),
+			std::make_tuple(&container<Excluded>()...));
+	}
+
+	// Make 'child' the first child of 'parent', see Relationship
+	void attach(Entity child, Entity parent) {
+		assert(Entity::is_alive(child) && Entity::is_alive(parent) && child != parent);
+		if (!relationships.has(parent))
+			relationships.emplace(parent);
+		if (!relationships.has(child))
+			relationships.emplace(child);
+		detach(child);
+		Relationship& parent_relationship = relationships.get(parent);
+		Relationship& child_relationship = relationships.get(child);
+		child_relationship.parent = parent;
+		child_relationship.next_sibling = parent_relationship.first_child;
+		parent_relationship.first_child = child;
+	}
+
+	// Unlink 'child' from its parent, its own children stay attached to it
+	void detach(Entity child) {
+		if (!relationships.has(child))
+			return;
+		Entity parent = relationships.read(child).parent;
+		if (parent != Entity::null() && relationships.has(parent)) {
+			Entity next = relationships.read(child).next_sibling;
+			if (relationships.read(parent).first_child == child)
+				relationships.get(parent).first_child = next;
+			else
+				for (Entity sibling = relationships.read(parent).first_child; sibling != Entity::null(); sibling = relationships.read(sibling).next_sibling)
+					if (relationships.read(sibling).next_sibling == child) {
+						relationships.get(sibling).next_sibling = next;
+						break;
+					}
+		}
+		Relationship& relationship = relationships.get(child);
+		relationship.parent = Entity::null();
+		relationship.next_sibling = Entity::null();
 	}
 
 	void remove_all_components_of(Entity e) {
-		// removes entity
-		for (ContainerInterface* reg : registry_list)
-			reg->remove(e);
+		// a stale handle must not touch the components of the entity that re-uses its slot
+		if (!Entity::is_alive(e))
+			return;
+		// children are removed with their parent
+		if (relationships.has(e)) {
+			detach(e);
+			while (relationships.read(e).first_child != Entity::null())
+				remove_all_components_of(relationships.read(e).first_child);
+		}
+		// removes entity, only from the containers it actually has a component in
+		storage.each_in(signature_of(e), [e](auto& container) { container.remove(e); });
+		// and releases its id for re-use, stale handles will fail has() checks
+		Entity::destroy(e);
+	}
+
+	// Remove the components of e that are part of 'components', the entity itself stays alive,
+	// e.g., registry.remove_components(e, registry.mask<Motion, Object>())
+	void remove_components(Entity e, Signature components) {
+		storage.each_in(signature_of(e) & components, [e](auto& container) { container.remove(e); });
+	}
+
+	// Serialize the complete ECS state (entity ids, the dense arrays of all containers and the context resources,
+	// except those excluded with context_in_snapshot) into 'blob'.
+	// Note, Mesh* components are pointers, so a snapshot is only meaningful within the process that took it.
+	void save_snapshot(std::vector<char>& blob) {
+		assert(commands.empty() && "Flush the registry before taking a snapshot");
+		SnapshotWriter writer(blob);
+		write_snapshot_header(writer);
+		Entity::save_slots(writer);
+		storage.each([&](auto& container) { container.save(writer); });
+		context.each_in_snapshot([&](auto& resource) { writer.write(resource); });
+	}
+
+	// Replace the complete ECS state with a snapshot taken by save_snapshot, recorded commands are dropped.
+	// Returns false if the blob doesn't match the current component layout (the state is left untouched)
+	// or is truncated (the registry is left empty).
+	bool load_snapshot(const std::vector<char>& blob) {
+		std::vector<char> header;
+		SnapshotWriter header_writer(header);
+		write_snapshot_header(header_writer);
+		if (blob.size() < header.size() || !std::equal(header.begin(), header.end(), blob.begin()))
+			return false;
+
+		commands.clear();
+		clear_all_components();
+		SnapshotReader reader(blob);
+		bool ok = reader.skip(header.size()) && Entity::load_slots(reader);
+		storage.each([&](auto& container) { ok = ok && container.load(reader); });
+		context.each_in_snapshot([&](auto& resource) { ok = ok && reader.read(resource); });
+		if (!ok || !reader.at_end())
+		{
+			clear_all_components();
+			return false;
+		}
+		motionObjects.refresh();
+		return true;
+	}
+
+	// Schedule e for removal at the next flush(), it is tagged PendingRemove until then.
+	// Use this instead of remove_all_components_of while iterating over containers.
+	void remove_deferred(Entity e) {
+		// a stale handle must not tag the entity that re-uses its slot
+		if (Entity::is_alive(e) && !pendingRemoves.has(e))
+			pendingRemoves.emplace(e);
+	}
+
+	// Sync point: apply the recorded component changes, then remove all entities tagged PendingRemove
+	// in one batched pass per container instead of one removal per entity and container
+	void flush() {
+		commands.apply(storage);
+		remove_pending();
+	}
+
+	// Create 'count' entities that all get a copy of every given component, appended to 'created', e.g.,
+	// registry.create_n(100, created, Motion(), Object(), Eatable()). Every container is grown once
+	// and then filled in one loop, instead of count separate emplaces per component type.
+	template <typename... Component>
+	void create_n(size_t count, std::vector<Entity>& created, const Component&... prototype) {
+		size_t first = created.size();
+		created.reserve(first + count);
+		for (size_t i = 0; i < count; i++)
+			created.push_back(Entity());
+		using expand = int[];
+		(void)expand{ 0, (container<Component>().insert_n(created.data() + first, count, prototype), 0)... };
+	}
+
+	// Remove all given entities (and their children) right away, in one batched pass per container.
+	// Other entities tagged PendingRemove stay tagged until the next flush().
+	// Note, like remove_all_components_of this must not be called while iterating over containers
+	void destroy_n(const std::vector<Entity>& entities) {
+		removal_batch.clear();
+		for (Entity e : entities)
+			if (Entity::is_alive(e))
+				add_to_removal_batch(e);
+		destroy_removal_batch();
+	}
+
+private:
+	// Remove all entities tagged PendingRemove
+	void remove_pending() {
+		if (pendingRemoves.size() == 0)
+			return;
+		removal_batch.clear();
+		for (Entity e : pendingRemoves)
+			add_to_removal_batch(e);
+		destroy_removal_batch();
+	}
+
+	// Add e to 'removal_batch' unless it is part of it already
+	void add_to_removal_batch(Entity e) {
+		if (is_in_removal_batch(e))
+			return;
+		if (e.index() >= in_removal_batch.size())
+			in_removal_batch.resize(e.index() + 1, 0);
+		in_removal_batch[e.index()] = 1;
+		removal_batch.push_back(e);
+	}
+
+	bool is_in_removal_batch(Entity e) const {
+		return e.index() < in_removal_batch.size() && in_removal_batch[e.index()];
+	}
+
+	// Remove all entities of 'removal_batch' and their children
+	void destroy_removal_batch() {
+		// a single pass finds the containers that any of the entities is in (only those have to be
+		// visited) and adds the children, which are removed with their parents. The batch grows while it is walked.
+		const Signature relationship_bit = storage.bit<Relationship>();
+		Signature touched = 0;
+		for (size_t i = 0; i < removal_batch.size(); i++) {
+			Signature signature = signature_of(removal_batch[i]);
+			touched |= signature;
+			if (!(signature & relationship_bit))
+				continue;
+			for (Entity child = relationships.read(removal_batch[i]).first_child; child != Entity::null(); child = relationships.read(child).next_sibling)
+				add_to_removal_batch(child);
+		}
+		// and unlinked from parents that stay
+		if (touched & relationship_bit)
+			for (Entity e : removal_batch)
+				if (relationships.has(e)) {
+					Entity parent = relationships.read(e).parent;
+					if (parent != Entity::null() && !is_in_removal_batch(parent))
+						detach(e);
+				}
+		storage.each_in(touched, [this](auto& container) { container.remove_batch(removal_batch); });
+		for (Entity e : removal_batch) {
+			in_removal_batch[e.index()] = 0;
+			Entity::destroy(e);
+		}
 	}
 };
 
@@ -1,6 +1,9 @@
 #include "world_init.hpp"
 #include "tiny_ecs_registry.hpp"
 
+// stlib
+#include <cfloat>
+
 
 Entity createSalmon(RenderSystem* renderer, vec2 pos)
 {
@@ -11,23 +14,26 @@ Entity createSalmon(RenderSystem* renderer, vec2 pos)
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Setting initial motion values
-	
+	// Note, the Object is emplaced last since adding the second component of the Motion/Object group
+	// re-orders both containers, which would invalidate a reference taken before
+	Motion& motion = registry.motions.emplace(entity);
+	motion.input_velocity = { 0.f, 0.f };
+	motion.acceleration = { 0.f, 0.f };
+
 	Object& object = registry.objects.emplace(entity);
 	object.position = pos;
 	object.angle = M_PI;
 	object.scale = mesh.original_size * 300.f;
 	object.scale.y *= -1;
 
-	Motion& motion = registry.motions.emplace(entity);
-	motion.input_velocity = { 0.f, 0.f };
-	motion.acceleration = { 0.f, 0.f };
-
 	BoundingBox& bb = registry.boundingBoxes.emplace(entity);
 	vec4 bb_info = calculate_AABB(object);
 	bb.bounding_box = vec2(bb_info.x, bb_info.y);
 	bb.pos = vec2(bb_info.z, bb_info.w);
 	createTrackerLines(entity);
 
+	registry.colliders.emplace(entity).layer = COLLISION_LAYER::PLAYER;
+
 	// create an empty Salmon component for our character
 	registry.players.emplace(entity);
 	registry.renderRequests.insert(
@@ -39,159 +45,6 @@ Entity createSalmon(RenderSystem* renderer, vec2 pos)
 	return entity;
 }
 
-Entity createFish(RenderSystem* renderer, vec2 position)
-{
-	// Reserve en entity
-	auto entity = Entity();
-
-	// Store a reference to the potentially re-used mesh object
-	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
-	registry.meshPtrs.emplace(entity, &mesh);
-
-	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
-	motion.input_velocity = { -50.f, 0.f };
-	motion.acceleration = { 0.f, 0.f };
-
-	// Setting initial values, scale is negative to make it face the opposite way
-	auto& object = registry.objects.emplace(entity);
-	object.position = position;
-	object.angle = 0.f;
-	object.scale = vec2({ -FISH_BB_WIDTH, FISH_BB_HEIGHT });
-
-	BoundingBox& bb = registry.boundingBoxes.emplace(entity);
-	vec4 bb_info = calculate_AABB(object);
-	bb.bounding_box = vec2(bb_info.x, bb_info.y);
-	bb.pos = vec2(bb_info.z, bb_info.w);
-	createTrackerLines(entity);
-
-	// Create an (empty) Bug component to be able to refer to all bug
-	registry.eatables.emplace(entity);
-	registry.renderRequests.insert(
-		entity,
-		{
-			TEXTURE_ASSET_ID::FISH,
-			EFFECT_ASSET_ID::TEXTURED,
-			GEOMETRY_BUFFER_ID::SPRITE
-		});
-
-	return entity;
-}
-
-Entity createPuffer(RenderSystem*renderer, vec2 position, float rand, float rand2) {
-	printf("spawning puffer");
-	auto entity = Entity();
-
-	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
-	registry.meshPtrs.emplace(entity, &mesh);
-
-	auto& motion = registry.motions.emplace(entity);
-	motion.input_velocity = { 0.f, -300.f };
-	motion.acceleration = { copysignf(300.f*(rand2/2 +0.5), rand), 0.f};
-	motion.initial_sign = copysignf(1.0, rand);
-
-	auto& object = registry.objects.emplace(entity);
-	object.angle = 0.f;
-	object.position = position;
-	object.scale = vec2({ -FISH_BB_WIDTH, FISH_BB_HEIGHT});
-
-	BoundingBox& bb = registry.boundingBoxes.emplace(entity);
-	vec4 bb_info = calculate_AABB(object);
-	bb.bounding_box = vec2(bb_info.x, bb_info.y);
-	bb.pos = vec2(bb_info.z, bb_info.w);
-	createTrackerLines(entity);
-
-	registry.eatables.emplace(entity).points = 5;
-
-	registry.renderRequests.insert(
-		entity,
-		{
-			TEXTURE_ASSET_ID::PUFFER,
-			EFFECT_ASSET_ID::TEXTURED,
-			GEOMETRY_BUFFER_ID::SPRITE
-		});
-	return entity;
-
-}
-
-Entity createEel(RenderSystem* renderer, vec2 position)
-{
-	auto entity = Entity();
-
-	// Store a reference to the potentially re-used mesh object (the value is stored in the resource cache)
-	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
-	registry.meshPtrs.emplace(entity, &mesh);
-
-	// Initialize the motion
-	auto& motion = registry.motions.emplace(entity);
-	motion.acceleration = { 0.f, 0.f };
-	motion.input_velocity = { -100.f, 0.f };
-
-	// Setting initial values, scale is negative to make it face the opposite way
-	auto& object = registry.objects.emplace(entity);
-	object.position = position;
-	object.angle = 0.f;
-	object.scale = vec2({ -EEL_BB_WIDTH, EEL_BB_HEIGHT });
-
-	BoundingBox& bb = registry.boundingBoxes.emplace(entity);
-	vec4 bb_info = calculate_AABB(object);
-	bb.bounding_box = vec2(bb_info.x, bb_info.y);
-	bb.pos = vec2(bb_info.z, bb_info.w);
-	printf("created bounding box with position %f %f and size %f %f\n", bb.pos.x, bb.pos.y, bb.bounding_box.x, bb.bounding_box.y);
-	printf("for reference, the object position is %f %f and scale is %f %f\n", object.position.x, object.position.y, object.scale.x, object.scale.y);
-	createTrackerLines(entity);
-	
-	// create an empty Eel component to be able to refer to all eels
-	registry.deadlys.emplace(entity);
-	registry.renderRequests.insert(
-		entity,
-		{
-			TEXTURE_ASSET_ID::EEL,
-			EFFECT_ASSET_ID::TEXTURED,
-			GEOMETRY_BUFFER_ID::SPRITE
-		});
-
-	return entity;
-}
-
-Entity createWhirlpool(RenderSystem* renderer, vec2 position, float rand) {
-	auto entity = Entity();
-
-	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
-	registry.meshPtrs.emplace(entity, &mesh);
-
-	auto& motion = registry.motions.emplace(entity);
-	motion.input_velocity = { 0.f, 0.f };
-	motion.acceleration = { 0.f, 0.f };
-
-	auto& object = registry.objects.emplace(entity);
-	object.angle = 0.f; // i want to slowly rotate the whirlpool
-	object.position = position;
-	object.scale = vec2({ -WHIRL_BB_WIDTH * rand, WHIRL_BB_HEIGHT * rand });
-
-	BoundingBox& bb = registry.boundingBoxes.emplace(entity);
-	vec4 bb_info = calculate_AABB(object);
-	bb.bounding_box = vec2(bb_info.x, bb_info.y);
-	bb.pos = vec2(bb_info.z, bb_info.w);
-	createTrackerLines(entity);
-
-	registry.deadlys.emplace(entity);
-	Attractor& attractor = registry.attractors.emplace(entity);
-	attractor.force *= rand;
-	attractor.radius *= rand;
-	registry.deathTimers.emplace(entity).counter_ms = WHIRLPOOL_DEATH_TIMER;
-	registry.renderRequests.insert(
-		entity,
-		{
-			TEXTURE_ASSET_ID::WHIRLPOOL,
-			EFFECT_ASSET_ID::TEXTURED,
-			GEOMETRY_BUFFER_ID::SPRITE
-		});
-
-	return entity;
-
-}
-
 Entity createLine(vec2 position, vec2 scale)
 {
 	Entity entity = Entity();
@@ -210,30 +63,74 @@ Entity createLine(vec2 position, vec2 scale)
 	object.position = position;
 	object.scale = scale;
 
+	// the line is only drawn, it collides with nothing
+	registry.colliders.emplace(entity).layer = COLLISION_LAYER::DECORATION;
+
 	// registry.debugComponents.emplace(entity);
 	return entity;
 }
 
+// A tracker line is drawn like a debug line, placeTrackerLine sets its position and scale
+static const RenderRequest tracker_line_request = {
+	TEXTURE_ASSET_ID::TEXTURE_COUNT,
+	EFFECT_ASSET_ID::EGG,
+	GEOMETRY_BUFFER_ID::DEBUG_LINE
+};
+static const Collider tracker_line_collider = { COLLISION_LAYER::DECORATION };
+
 void createTrackerLines(Entity entity) {
 	printf("creating tracker lines ");
-	BoundingBox bb = registry.boundingBoxes.get(entity);
+	const BoundingBox& bb = registry.boundingBoxes.read(entity);
 	printf("for bounding box with position %f %f and size %f %f\n", bb.pos.x, bb.pos.y, bb.bounding_box.x, bb.bounding_box.y);
-	// top line
-	Entity line = createLine(vec2(bb.pos.x, bb.pos.y-(bb.bounding_box.y/2)), { bb.bounding_box.x, 10 });
-	registry.boundingLines.emplace(line, BOUNDING_LINE_POS::TOP, entity);
-	// bottom line
-	line = createLine(vec2(bb.pos.x, bb.pos.y + (bb.bounding_box.y / 2)), { bb.bounding_box.x, 10 });
-	registry.boundingLines.emplace(line, BOUNDING_LINE_POS::BOTTOM, entity);
-	// left line
-	line = createLine(vec2(bb.pos.x - (bb.bounding_box.x / 2), bb.pos.y), { 10, bb.bounding_box.y });
-	registry.boundingLines.emplace(line, BOUNDING_LINE_POS::LEFT, entity);
-	// right line
-	line = createLine(vec2(bb.pos.x + (bb.bounding_box.x / 2), bb.pos.y), { 10, bb.bounding_box.y });
-	registry.boundingLines.emplace(line, BOUNDING_LINE_POS::RIGHT, entity);
+	// the four lines are created in one batch, they only differ in position and scale
+	std::vector<Entity> lines;
+	registry.create_n(4, lines, tracker_line_request, tracker_line_collider, Object());
+	for (int i = 0; i < 4; i++) {
+		const BoundingLine& bl = registry.boundingLines.emplace(lines[i], (BOUNDING_LINE_POS)i);
+		placeTrackerLine(bl, bb, registry.objects.get(lines[i]));
+		// the lines are children of the entity, so they are removed together with it
+		registry.attach(lines[i], entity);
+	}
 
 	return;
 }
 
+void restoreTrackerLines(Entity entity) {
+	// the lines are parked with their owner and never removed on their own, see WorldSystem::park_pooled
+	const BoundingBox& bb = registry.boundingBoxes.read(entity);
+	for (Entity child = registry.relationships.read(entity).first_child; child != Entity::null(); child = registry.relationships.read(child).next_sibling) {
+		if (!registry.boundingLines.has(child))
+			continue;
+		const BoundingLine& bl = registry.boundingLines.read(child);
+		registry.renderRequests.insert(child, tracker_line_request);
+		registry.colliders.insert(child, tracker_line_collider);
+		placeTrackerLine(bl, bb, registry.objects.emplace(child));
+	}
+}
+
+// Put a tracker line on its side of the bounding box
+void placeTrackerLine(const BoundingLine& bl, const BoundingBox& bb, Object& object) {
+	object.angle = 0.f;
+	switch (bl.position) {
+	case BOUNDING_LINE_POS::TOP:
+		object.position = vec2(bb.pos.x, bb.pos.y - (bb.bounding_box.y / 2));
+		object.scale = vec2(bb.bounding_box.x, 10);
+		break;
+	case BOUNDING_LINE_POS::BOTTOM:
+		object.position = vec2(bb.pos.x, bb.pos.y + (bb.bounding_box.y / 2));
+		object.scale = vec2(bb.bounding_box.x, 10);
+		break;
+	case BOUNDING_LINE_POS::LEFT:
+		object.position = vec2(bb.pos.x - (bb.bounding_box.x / 2), bb.pos.y);
+		object.scale = vec2(10, bb.bounding_box.y);
+		break;
+	case BOUNDING_LINE_POS::RIGHT:
+		object.position = vec2(bb.pos.x + (bb.bounding_box.x / 2), bb.pos.y);
+		object.scale = vec2(10, bb.bounding_box.y);
+		break;
+	}
+}
+
 
 // Function to compute AABB with position as center
 vec4 calculate_AABB(Object& obj) {
@@ -18,6 +18,9 @@ const size_t WHIRLPOOL_SPAWN_DELAY_MS = 8000;
 const size_t PUFFER_SPAWN_DELAY_MS = 2000 * 5;
 const size_t PUFFER_TRAJ_SWAP = 1000;
 
+// Registry memory reports are appended here on every restart and on exit, see dump_memory_report
+const char* memory_report_path = "registry_memory.jsonl";
+
 // create the underwater world
 WorldSystem::WorldSystem()
 	: points(0)
@@ -28,10 +31,17 @@ WorldSystem::WorldSystem()
 	, keyLeft(false)
 	, keyRight(false) 
 	, state(0) 
-	, next_puffer_spawn(0.f) {
+	, next_puffer_spawn(0.f)
+	, objects_version(0)
+	, bounding_boxes_version(0)
+	, quick_save_points(0) {
 	// Seeding rng with random device
 	rng = std::default_random_engine(std::random_device()());
 	printf("Color shift and distortion are active\n");
+
+	for (int i = 0; i < collision_layer_count; i++)
+		for (int j = 0; j < collision_layer_count; j++)
+			collision_handlers[i][j] = nullptr;
 }
 
 WorldSystem::~WorldSystem() {
@@ -46,7 +56,8 @@ WorldSystem::~WorldSystem() {
 
 	Mix_CloseAudio();
 
-	// Destroy all created components
+	// Record the final memory use, then destroy all created components
+	dump_memory_report("exit");
 	registry.clear_all_components();
 
 	// Close the window
@@ -132,6 +143,26 @@ GLFWwindow* WorldSystem::create_window() {
 
 void WorldSystem::init(RenderSystem* renderer_arg) {
 	this->renderer = renderer_arg;
+
+	// Entity templates used by the spawns in step(), each with its own pool, in the order of PoolId
+	bool prefabs_loaded = prefabs.load(data_path() + "/prefabs.txt");
+	assert(prefabs_loaded);
+	const char* pooled_prefabs[POOL_COUNT] = { "fish", "puffer", "eel", "whirlpool" };
+	for (unsigned int i = 0; i < POOL_COUNT; i++) {
+		const Prefab* prefab = prefabs.find(pooled_prefabs[i]);
+		assert(prefab != nullptr);
+		pools.push_back(EntityPool(i, prefab));
+	}
+	// The collisions the game reacts to, all other pairs of layers are never tested.
+	// Note, the filter is part of the registry context, so this has to happen before the start snapshot is taken
+	on_collision(COLLISION_LAYER::PLAYER, COLLISION_LAYER::HAZARD, &WorldSystem::player_hits_hazard);
+	on_collision(COLLISION_LAYER::PLAYER, COLLISION_LAYER::ATTRACTOR, &WorldSystem::player_hits_hazard);
+	on_collision(COLLISION_LAYER::PLAYER, COLLISION_LAYER::PREY, &WorldSystem::player_eats_prey);
+	on_collision(COLLISION_LAYER::ATTRACTOR, COLLISION_LAYER::PREY, &WorldSystem::attractor_drowns);
+	on_collision(COLLISION_LAYER::ATTRACTOR, COLLISION_LAYER::HAZARD, &WorldSystem::attractor_drowns);
+	// whirlpools drown each other too, like everything else that isn't the player
+	on_collision(COLLISION_LAYER::ATTRACTOR, COLLISION_LAYER::ATTRACTOR, &WorldSystem::attractor_drowns);
+
 	// Playing background music indefinitely
 	Mix_PlayMusic(background_music, -1);
 	fprintf(stderr, "Loaded music\n");
@@ -148,32 +179,33 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 	glfwSetWindowTitle(window, title_ss.str().c_str());
 
 	// Remove debug info from the last step
-	//while (registry.debugComponents.entities.size() > 0)
-	//    registry.remove_all_components_of(registry.debugComponents.entities.back());
+	//while (registry.debugComponents.size() > 0)
+	//    registry.remove_all_components_of(registry.debugComponents.front());
 
 	// Removing out of screen entities
 	auto& objects_registry = registry.objects;
 
 	// Remove entities that leave the screen on the left side
-	// Iterate backwards to be able to remove without interfering with the next object to visit
-	// (the containers exchange the last element with the current)
-	for (int i = (int)objects_registry.components.size()-1; i>=0; --i) {
+	// The removal is deferred to the next registry.flush(), so the containers don't change while we iterate
+	for (uint i = 0; i < objects_registry.components.size(); i++) {
 	    Object& object = objects_registry.components[i];
 		if ((object.position.x + abs(object.scale.x) < 0.f) || (object.position.y + abs(object.scale.y) > window_height_px + 100)) {
 			if(!registry.players.has(objects_registry.entities[i])) // don't remove the player
-				registry.remove_all_components_of(objects_registry.entities[i]);
+				registry.remove_deferred(objects_registry.entities[i]);
 		}
 	}
 
 	// spawn new eels
 	next_eel_spawn -= elapsed_ms_since_last_update;
-	if (registry.deadlys.components.size() <= MAX_NUM_EELS && next_eel_spawn < 0.f) {
+	if (registry.deadlys.size() <= MAX_NUM_EELS && next_eel_spawn < 0.f) {
 		// reset timer
 		next_eel_spawn = (EEL_SPAWN_DELAY_MS / 2) + uniform_dist(rng) * (EEL_SPAWN_DELAY_MS / 2);
 
 		// create Eel with random initial position
         // createEel(renderer, vec2(50.f + uniform_dist(rng) * (window_width_px - 100.f), 100.f));
-		createEel(renderer, vec2(window_width_px + 50, window_height_px*uniform_dist(rng)));
+		PrefabOverrides eel;
+		eel.position = vec2(window_width_px + 50, window_height_px*uniform_dist(rng));
+		pools[EEL_POOL].spawn(renderer, eel);
 	}
 
 	// spawn fish
@@ -181,7 +213,9 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 	if (registry.eatables.components.size() <= MAX_NUM_FISH && next_fish_spawn < 0.f) {
 		// !!!  TODO A1: create new fish with createFish({0,0}), see eels above (done)
 		next_fish_spawn = (FISH_SPAWN_DELAY_MS / 2) + uniform_dist(rng) * (FISH_SPAWN_DELAY_MS / 2);
-		createFish(renderer, vec2(window_width_px + 50, window_height_px * uniform_dist(rng)));
+		PrefabOverrides fish;
+		fish.position = vec2(window_width_px + 50, window_height_px * uniform_dist(rng));
+		pools[FISH_POOL].spawn(renderer, fish);
 	}
 
 	// advanced mechanics
@@ -190,13 +224,21 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 		next_whirl_spawn -= elapsed_ms_since_last_update;
 		if (registry.attractors.components.size() <= MAX_NUM_WHIRL && next_whirl_spawn < 0.f) {
 			next_whirl_spawn = (WHIRLPOOL_SPAWN_DELAY_MS / 2) + uniform_dist(rng) * (WHIRLPOOL_SPAWN_DELAY_MS / 2);
-			createWhirlpool(renderer, vec2((window_width_px-100) * uniform_dist(rng) + 50, (window_height_px-70) * uniform_dist(rng) + 35), uniform_dist(rng) + 0.25);
+			PrefabOverrides whirlpool;
+			whirlpool.position = vec2((window_width_px-100) * uniform_dist(rng) + 50, (window_height_px-70) * uniform_dist(rng) + 35);
+			whirlpool.size = uniform_dist(rng) + 0.25;
+			pools[WHIRLPOOL_POOL].spawn(renderer, whirlpool);
 		}
 
 		next_puffer_spawn -= elapsed_ms_since_last_update;
 		if (next_puffer_spawn < 0.f) {
 			next_puffer_spawn = (PUFFER_SPAWN_DELAY_MS / 2) + uniform_dist(rng) * (PUFFER_SPAWN_DELAY_MS / 2);
-			createPuffer(renderer, vec2((window_width_px)*uniform_dist(rng), window_height_px), uniform_dist(rng) - 0.5f, uniform_dist(rng));
+			// the puffer drifts left or right with a random strength
+			PrefabOverrides puffer;
+			puffer.position = vec2((window_width_px)*uniform_dist(rng), window_height_px);
+			float direction = uniform_dist(rng) - 0.5f;
+			puffer.acceleration_scale.x = copysignf(uniform_dist(rng) / 2 + 0.5f, direction);
+			pools[PUFFER_POOL].spawn(renderer, puffer);
 		}
 
 
@@ -204,8 +246,7 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 
 	// Processing the salmon state
 	// Added functionality to remove dead entities
-	assert(registry.screenStates.components.size() <= 1);
-    ScreenState &screen = registry.screenStates.components[0];
+	ScreenState& screen = registry.ctx<ScreenState>();
 
     float min_counter_ms = 3000.f;
 	for (Entity entity : registry.deathTimers.entities) {
@@ -222,7 +263,7 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 				screen.darken_screen_factor = 0;
 				restart_game();
 				if (state == 1) {
-					for (Entity player : registry.players.entities) {
+					for (Entity player : registry.players) {
 						registry.objects.get(player).scale /= 1.5f;
 					}
 				}
@@ -232,8 +273,7 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 		else {
 			// remove the entity once it dies
 			if (counter.counter_ms < 0) {
-				registry.deathTimers.remove(entity);
-				registry.remove_all_components_of(entity);
+				registry.remove_deferred(entity);
 			}
 		}
 
@@ -246,10 +286,13 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 		LightUp& counter = registry.lightUps.get(entity);
 		counter.counter_ms -= elapsed_ms_since_last_update;
 		if (counter.counter_ms < 0) {
-			registry.lightUps.remove(entity);
+			registry.commands.remove<LightUp>(entity);
 		}
 	}
 	
+	// fish, eels, ... that were removed go back to their pool
+	park_pooled();
+
 	// update bounding boxes
 	update_bounding_boxes();
 
@@ -259,78 +302,103 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 	return true;
 }
 
+// Park the pooled entities that are scheduled for removal instead of destroying them at the next flush.
+// Tracker lines that left the screen before their owner stay attached to it, they are parked or
+// removed together with the owner, so a re-used entity gets its own lines back.
+void WorldSystem::park_pooled() {
+	parking.clear();
+	for (Entity entity : registry.pendingRemoves)
+		if (registry.pooled.has(entity) || (registry.boundingLines.has(entity) && registry.relationships.has(entity)
+			&& registry.relationships.read(entity).parent != Entity::null()))
+			parking.push_back(entity);
+	for (Entity entity : parking) {
+		registry.pendingRemoves.remove(entity);
+		if (registry.pooled.has(entity))
+			pools[registry.pooled.read(entity).pool].park(entity);
+	}
+}
+
 
 void WorldSystem::update_bounding_boxes() {
-	for (Entity entity : registry.boundingBoxes.entities) {
+	// only objects that moved, rotated or were rescaled since the last update need a new AABB
+	unsigned int since = objects_version;
+	objects_version = registry.objects.checkpoint();
+	registry.objects.each_changed_since(since, [](Entity entity, Object& object) {
+		if (!registry.boundingBoxes.has(entity))
+			return;
 		BoundingBox& bb = registry.boundingBoxes.get(entity);
-		Object& object = registry.objects.get(entity);
 		vec4 bb_info = calculate_AABB(object);
 		bb.bounding_box = vec2(bb_info.x, bb_info.y);
 		bb.pos = vec2(bb_info.z, bb_info.w);
-	}
+	});
 	return;
 }
 
 void WorldSystem::update_bounding_lines() {
-	// remember to check if entity exists before updating!!
-	int count_skipped = 0;
-	for (Entity entity : registry.boundingLines.entities) {
-		BoundingLine& bl = registry.boundingLines.get(entity);
-		Object& object = registry.objects.get(entity);
-		Entity entity_bb = bl.entity;
-		// check if registry still has the bounding box
-		if (!registry.boundingBoxes.has(entity_bb)) {
-			registry.remove_all_components_of(entity);
-			continue;
-		}
-		// if so, continue
-		BoundingBox& bb = registry.boundingBoxes.get(entity_bb);
-		switch (bl.position) {
-		case BOUNDING_LINE_POS::TOP:
-			object.position = vec2(bb.pos.x, bb.pos.y - (bb.bounding_box.y / 2));
-			object.scale = vec2(bb.bounding_box.x, 10);
-			break;
-		case BOUNDING_LINE_POS::BOTTOM:
-			object.position = vec2(bb.pos.x, bb.pos.y + (bb.bounding_box.y / 2));
-			object.scale = vec2(bb.bounding_box.x, 10);
-			break;
-		case BOUNDING_LINE_POS::LEFT:
-			object.position = vec2(bb.pos.x - (bb.bounding_box.x / 2), bb.pos.y);
-			object.scale = vec2(10, bb.bounding_box.y);
-			break;
-		case BOUNDING_LINE_POS::RIGHT:
-			object.position = vec2(bb.pos.x + (bb.bounding_box.x / 2), bb.pos.y);
-			object.scale = vec2(10, bb.bounding_box.y);
-			break;
+	// A single pass down the hierarchy: every bounding box that changed since the last update places
+	// the tracker lines among its children. Lines are removed together with their parent, so there are no orphans.
+	unsigned int since = bounding_boxes_version;
+	bounding_boxes_version = registry.boundingBoxes.checkpoint();
+	registry.boundingBoxes.each_changed_since(since, [](Entity parent, BoundingBox& bb) {
+		if (!registry.relationships.has(parent))
+			return;
+		for (Entity child = registry.relationships.read(parent).first_child; child != Entity::null(); child = registry.relationships.read(child).next_sibling) {
+			if (registry.boundingLines.has(child))
+				placeTrackerLine(registry.boundingLines.read(child), bb, registry.objects.get(child));
 		}
-	}
+	});
 	return;
 }
 
+// Append the registry memory report to memory_report_path, one JSON object per line
+void WorldSystem::dump_memory_report(const char* event) {
+	FILE* file = fopen(memory_report_path, "a");
+	if (file == nullptr)
+		return;
+	registry.write_memory_report(file, event);
+	fprintf(file, "{\"event\":\"%s\",\"pools\":[", event);
+	for (size_t i = 0; i < pools.size(); i++)
+		fprintf(file, "%s{\"prefab\":\"%s\",\"hits\":%zu,\"misses\":%zu,\"parked\":%zu}", i == 0 ? "" : ",",
+			pools[i].get_prefab().name.c_str(), pools[i].hits, pools[i].misses, pools[i].parked_count());
+	fprintf(file, "]}\n");
+	fclose(file);
+}
+
 // Reset the world state to its initial state
 void WorldSystem::restart_game() {
 	// Debugging for memory/component leaks
 	registry.list_all_components();
+	dump_memory_report("restart");
 	printf("Restarting\n");
 
 	// Reset the game speed
 	current_speed = 1.f;
 
-	// Remove all entities that we created
-	// All that have a motion, we could also iterate over all fish, eels, ... but that would be more cumbersome
-	while (registry.motions.entities.size() > 0)
-	    registry.remove_all_components_of(registry.motions.entities.back());
+	// Go back to the state right after the first start, which replaces all entities that we created since
+	if (!start_snapshot.empty() && registry.load_snapshot(start_snapshot)) {
+		player_salmon = registry.players.front();
+		for (EntityPool& pool : pools)
+			pool.rebuild();
+	}
+	else {
+		// Remove all entities that we created
+		// All that have a motion, we could also iterate over all fish, eels, ... but that would be more cumbersome
+		while (registry.motions.entities.size() > 0)
+			registry.remove_all_components_of(registry.motions.entities.back());
 
-	// Debugging for memory/component leaks
-	registry.list_all_components();
+		// create a new Salmon
+		// player_salmon = createSalmon(renderer, { window_width_px/2, window_height_px - 200 });
+		player_salmon = createSalmon(renderer, {0,0});
+		registry.colors.emplace(player_salmon, vec3(1, 0.8f, 0.8f));
+
+		// make a line
+		createLine(vec2(window_width_px/2, window_height_px/2), vec2(500, 10));
 
-	// create a new Salmon
-	// player_salmon = createSalmon(renderer, { window_width_px/2, window_height_px - 200 });
-	player_salmon = createSalmon(renderer, {0,0});
-	registry.colors.emplace(player_salmon, vec3(1, 0.8f, 0.8f));
+		registry.save_snapshot(start_snapshot);
+	}
 
-	// make a line
-	Entity line = createLine(vec2(window_width_px/2, window_height_px/2), vec2(500, 10));
+	// Debugging for memory/component leaks
+	registry.list_all_components();
 
 	// Reset the points
 	points = 0;
@@ -340,83 +408,93 @@ void WorldSystem::restart_game() {
 	next_puffer_spawn = 0.f;
 }
 
+void WorldSystem::on_collision(COLLISION_LAYER layer, COLLISION_LAYER other_layer, CollisionHandler handler) {
+	collision_handlers[(int)layer][(int)other_layer] = handler;
+	registry.ctx<CollisionFilter>().enable(layer, other_layer);
+}
+
 // Compute collisions between entities
 void WorldSystem::handle_collisions() {
-	// Loop over all collisions detected by the physics system
+	// Loop over all collisions detected by the physics system, the layers of the two entities select the handler
 	auto& collisionsRegistry = registry.collisions;
 	for (uint i = 0; i < collisionsRegistry.components.size(); i++) {
 		// The entity and its collider
 		Entity entity = collisionsRegistry.entities[i];
-		Entity entity_other = collisionsRegistry.components[i].other;
+		const Collision& collision = collisionsRegistry.components[i];
+		CollisionHandler handler = collision_handlers[(int)collision.layer][(int)collision.other_layer];
+		if (handler == nullptr)
+			continue;
 
-		// for now, we are only interested in collisions that involve the salmon
-		if (registry.players.has(entity)) {
-			//Player& player = registry.players.get(entity);
-
-			// Checking Player - Deadly collisions
-			if (registry.deadlys.has(entity_other)) {
-				// initiate death unless already dying
-				if (!registry.deathTimers.has(entity) && (!registry.deathTimers.has(entity_other) || registry.attractors.has(entity_other))) {
-					// Scream, reset timer, and make the salmon sink
-					registry.deathTimers.emplace(entity);
-					Mix_PlayChannel(-1, salmon_dead_sound, 0);
-					assert(registry.motions.has(entity) && "Player does not have motion!");
-					Motion& motion = registry.motions.get(entity);
-					Object& object = registry.objects.get(entity);
-
-					// change orientation
-					object.angle = 0.f;
-					motion.input_velocity.y = -100.f;
-					motion.input_velocity.x = 0.f;
-
-					// make red
-					registry.colors.get(entity) = vec3(1.f, 0.f, 0.f);
+		// entities that are about to be removed take no further part
+		if (registry.pendingRemoves.has(entity) || registry.pendingRemoves.has(collision.other))
+			continue;
 
-				}
-			}
-			// Checking Player - Eatable collisions
-			else if (registry.eatables.has(entity_other)) {
-				if (!registry.deathTimers.has(entity) && !registry.deathTimers.has(entity_other)) {
-					// chew, count points, and set the LightUp timer
-					points += registry.eatables.get(entity_other).points;
-					registry.remove_all_components_of(entity_other);
-					Mix_PlayChannel(-1, salmon_eat_sound, 0);
-					
-
-					// !!! TODO A1: create a new struct called LightUp in components.hpp and add an instance to the salmon entity by modifying the ECS registry
-					if (!registry.lightUps.has(entity)) {
-						registry.lightUps.emplace(entity);
-					}
-					else {
-						registry.lightUps.get(entity).counter_ms = 500.f;
-					}
-				}
-			}
-		} 
-		// handling whirlpool kills
-		else if (registry.attractors.has(entity)) {
-			if (!registry.players.has(entity_other)) {
-				if (!registry.deathTimers.has(entity_other)) {
-					registry.deathTimers.emplace(entity_other);
-					Mix_PlayChannel(-1, salmon_dead_sound, 0);
-					Motion& motion = registry.motions.get(entity_other);
-					Object& object = registry.objects.get(entity_other);
-					object.angle = M_PI;
-					motion.input_velocity.y = 100.f;
-					motion.input_velocity.x = 0.f;
-					motion.acceleration = { 0,0 };
-
-					// death
-					if (registry.colors.has(entity_other)) {
-						registry.colors.get(entity_other) = vec3(1.f, 0.f, 0.f);
-					}
-				}
-			}
-		}
+		(this->*handler)(entity, collision.other);
 	}
 
 	// Remove all collisions from this simulation step
 	registry.collisions.clear();
+
+	// the fish that were eaten go back to their pool
+	park_pooled();
+}
+
+// The salmon ran into an eel or a whirlpool
+void WorldSystem::player_hits_hazard(Entity player, Entity hazard) {
+	// initiate death unless already dying
+	if (!registry.deathTimers.has(player) && (!registry.deathTimers.has(hazard) || registry.attractors.has(hazard))) {
+		// Scream, reset timer, and make the salmon sink
+		registry.deathTimers.emplace(player);
+		Mix_PlayChannel(-1, salmon_dead_sound, 0);
+		assert(registry.motions.has(player) && "Player does not have motion!");
+		Motion& motion = registry.motions.get(player);
+		Object& object = registry.objects.get(player);
+
+		// change orientation
+		object.angle = 0.f;
+		motion.input_velocity.y = -100.f;
+		motion.input_velocity.x = 0.f;
+
+		// make red
+		registry.colors.get(player) = vec3(1.f, 0.f, 0.f);
+	}
+}
+
+// The salmon caught a fish or a puffer
+void WorldSystem::player_eats_prey(Entity player, Entity prey) {
+	if (!registry.deathTimers.has(player) && !registry.deathTimers.has(prey)) {
+		// chew, count points, and set the LightUp timer
+		points += registry.eatables.get(prey).points;
+		registry.remove_deferred(prey);
+		Mix_PlayChannel(-1, salmon_eat_sound, 0);
+
+		// !!! TODO A1: create a new struct called LightUp in components.hpp and add an instance to the salmon entity by modifying the ECS registry
+		if (!registry.lightUps.has(player)) {
+			registry.lightUps.emplace(player);
+		}
+		else {
+			registry.lightUps.get(player).counter_ms = 500.f;
+		}
+	}
+}
+
+// A whirlpool kills everything but the salmon, which dies in player_hits_hazard
+void WorldSystem::attractor_drowns(Entity, Entity victim) {
+	if (!registry.deathTimers.has(victim)) {
+		registry.deathTimers.emplace(victim);
+		Mix_PlayChannel(-1, salmon_dead_sound, 0);
+		Motion& motion = registry.motions.get(victim);
+		Object& object = registry.objects.get(victim);
+		object.angle = M_PI;
+		motion.input_velocity.y = 100.f;
+		motion.input_velocity.x = 0.f;
+		motion.acceleration = { 0,0 };
+
+		// death
+		if (registry.colors.has(victim)) {
+			registry.colors.get(victim) = vec3(1.f, 0.f, 0.f);
+		}
+	}
 }
 
 // Should the game be over ?
@@ -427,13 +505,13 @@ bool WorldSystem::is_over() const {
 // On key callback
 void WorldSystem::on_key(int key, int, int action, int mod) {
 	// handling keypresses:
-	if (registry.players.entities.size() > 0 && !registry.deathTimers.has(registry.players.entities[0])) {
+	if (registry.players.size() > 0 && !registry.deathTimers.has(registry.players.front())) {
 		// Member variables to keep track of key states
 
 		// Key handler
 		if (key == GLFW_KEY_LEFT || key == GLFW_KEY_DOWN || key == GLFW_KEY_RIGHT || key == GLFW_KEY_UP) {
-			assert(registry.players.entities.size() > 0 && "No player found for moving.");
-			Entity& player_salmon = registry.players.entities[0];
+			assert(registry.players.size() > 0 && "No player found for moving.");
+			Entity player_salmon = registry.players.front();
 			Motion& motion = registry.motions.get(player_salmon);
 			float speed = 100.f;
 
@@ -476,7 +554,7 @@ void WorldSystem::on_key(int key, int, int action, int mod) {
 		printf("Switching to Advanced Mode\n"); // TODO: RESET ANY ADVANCED MODE SPECIFIC STATES
 		state = 1;
 		restart_game();
-		for (Entity player : registry.players.entities) {
+		for (Entity player : registry.players) {
 			registry.objects.get(player).scale /= 1.5f;
 		}
 	}
@@ -497,12 +575,28 @@ void WorldSystem::on_key(int key, int, int action, int mod) {
 		glfwGetWindowSize(window, &w, &h);
         restart_game();
 		if (state == 1) {
-			for (Entity player : registry.players.entities) {
+			for (Entity player : registry.players) {
 				registry.objects.get(player).scale /= 1.5f;
 			}
 		}
 	}
 
+	// Quick save and quick load of the whole game state
+	if (action == GLFW_RELEASE && key == GLFW_KEY_F5) {
+		registry.save_snapshot(quick_save);
+		quick_save_points = points;
+		printf("Saved the game (%zu bytes)\n", quick_save.size());
+	}
+	if (action == GLFW_RELEASE && key == GLFW_KEY_F9 && !quick_save.empty()) {
+		if (registry.load_snapshot(quick_save)) {
+			player_salmon = registry.players.front();
+			points = quick_save_points;
+			for (EntityPool& pool : pools)
+				pool.rebuild();
+			printf("Loaded the game\n");
+		}
+	}
+
 	// Debugging
 	if (key == GLFW_KEY_D) {
 		if (action == GLFW_RELEASE)
@@ -539,9 +633,9 @@ void WorldSystem::on_mouse_move(vec2 mouse_position) {
 	*/
 
 	// again, we're getting the salmon entity via players[0] because we're only dealing with one player
-	if (registry.players.entities.size() > 0 && !registry.deathTimers.has(registry.players.entities[0])) {
-		assert(registry.players.entities.size() > 0 && "No player found for rotating.");
-		Entity& player_salmon = registry.players.entities[0]; // just gonna use the first player in the players ComponentContainer
+	if (registry.players.size() > 0 && !registry.deathTimers.has(registry.players.front())) {
+		assert(registry.players.size() > 0 && "No player found for rotating.");
+		Entity player_salmon = registry.players.front(); // just gonna use the first player in the players ComponentContainer
 		Object& object = registry.objects.get(player_salmon);
 
 		vec2 diff = object.position - mouse_position;
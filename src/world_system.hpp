@@ -12,6 +12,8 @@
 #include <SDL_mixer.h>
 
 #include "render_system.hpp"
+#include "prefab.hpp"
+#include "entity_pool.hpp"
 
 // Container for all our entities and game logic. Individual rendering / update is
 // deferred to the relative update() methods
@@ -51,6 +53,25 @@ private:
 	// restart level
 	void restart_game();
 
+	// Handles the collision of 'entity' with 'other', see on_collision
+	typedef void (WorldSystem::*CollisionHandler)(Entity entity, Entity other);
+
+	// Call 'handler' for collisions of an entity on 'layer' with one on 'other_layer', and enable the
+	// pair in the CollisionFilter. Every collision is reported once from each side, so a handler
+	// registered for (a, b) only sees the entity of layer a as its first argument.
+	void on_collision(COLLISION_LAYER layer, COLLISION_LAYER other_layer, CollisionHandler handler);
+
+	// The collision handlers, registered in init()
+	void player_hits_hazard(Entity player, Entity hazard);
+	void player_eats_prey(Entity player, Entity prey);
+	void attractor_drowns(Entity attractor, Entity victim);
+
+	// Hand removed entities that belong to a pool back to it, tracker lines stay with their owner
+	void park_pooled();
+
+	// Write the registry memory use to memory_report_path, to spot containers that keep growing across restarts
+	void dump_memory_report(const char* event);
+
 	// OpenGL window handle
 	GLFWwindow* window;
 
@@ -67,6 +88,28 @@ private:
 	Entity player_salmon;
 	int state;
 
+	// Handler of every (layer, other layer) pair, nullptr for pairs nobody handles
+	CollisionHandler collision_handlers[collision_layer_count][collision_layer_count];
+
+	// Templates of the spawned entities, loaded from data/prefabs.txt
+	PrefabLibrary prefabs;
+
+	// One pool per spawned prefab, indexed by Pooled::pool
+	enum PoolId { FISH_POOL, PUFFER_POOL, EEL_POOL, WHIRLPOOL_POOL, POOL_COUNT };
+	std::vector<EntityPool> pools;
+	std::vector<Entity> parking; // scratch list of park_pooled
+
+	// Container versions seen by the last bounding box and bounding line updates, see ComponentContainer::checkpoint
+	unsigned int objects_version;
+	unsigned int bounding_boxes_version;
+
+	// Registry snapshot of a freshly started game, restored by restart_game
+	std::vector<char> start_snapshot;
+
+	// Quick save (F5) and quick load (F9) of the game state
+	std::vector<char> quick_save;
+	unsigned int quick_save_points;
+
 	// Keyboard state
 	bool keyUp, keyDown, keyLeft, keyRight;
 